@@ -0,0 +1,103 @@
+#define GLM_ENABLE_EXPERIMENTAL
+
+#include "Animation.h"
+#include "glm/gtx/easing.hpp"
+#include "glm/gtx/spline.hpp"
+#include "glm/ext/vector_float1.hpp"
+#include <algorithm>
+#include <cmath>
+
+void AnimationCurve::add_key(float time, float value, Interpolation interpolation)
+{
+    Keyframe key = { time, value, interpolation };
+    std::vector<Keyframe>::iterator position = std::upper_bound(m_keys.begin(), m_keys.end(), key,
+        [](const Keyframe& a, const Keyframe& b) { return a.time < b.time; });
+    m_keys.insert(position, key);
+}
+
+float AnimationCurve::evaluate(float time, float duration) const
+{
+    if (m_keys.empty()) return 0.0f;
+    const int count = (int)m_keys.size();
+    if (count == 1) return m_keys[0].value;
+
+    // the key at or before time -- before the first key we are still blending out of the last one
+    int current = count - 1;
+    for (int i = 0; i < count; i++)
+    {
+        if (m_keys[i].time > time) break;
+        current = i;
+    }
+    int next = (current + 1) % count;
+
+    const Keyframe& from = m_keys[current];
+    const Keyframe& to = m_keys[next];
+
+    // spans that wrap round the end of the loop are measured through it
+    float span = to.time - from.time;
+    if (span <= 0.0f) span += duration;
+    float elapsed = time - from.time;
+    if (elapsed < 0.0f) elapsed += duration;
+    float s = span > 0.0f ? elapsed / span : 0.0f;
+
+    switch (from.interpolation)
+    {
+    case INTERPOLATION_EASE_IN_OUT:
+        return from.value + (to.value - from.value) * glm::sineEaseInOut(s);
+
+    case INTERPOLATION_CATMULL_ROM:
+    {
+        const Keyframe& before = m_keys[(current + count - 1) % count];
+        const Keyframe& after = m_keys[(next + 1) % count];
+        return glm::catmullRom(glm::vec1(before.value), glm::vec1(from.value), glm::vec1(to.value), glm::vec1(after.value), s).x;
+    }
+
+    default:
+        return from.value + (to.value - from.value) * s;
+    }
+}
+
+AnimationClip::AnimationClip() : m_duration(0.0f), m_sample_rate(0.0f) {}
+
+void AnimationClip::initialise(float duration, int sample_rate)
+{
+    m_duration = duration;
+    m_sample_rate = (float)sample_rate;
+}
+
+void AnimationClip::bake()
+{
+    int sample_count = (int)std::ceil(m_duration * m_sample_rate);
+    if (sample_count < 1) sample_count = 1;
+
+    // stretched slightly so the last sample lands exactly on the loop point
+    m_sample_rate = sample_count / m_duration;
+
+    for (int channel = 0; channel < NUMBER_OF_CHANNELS; channel++)
+    {
+        std::vector<float>& samples = m_samples[channel];
+        samples.clear();
+        if (m_curves[channel].is_empty()) continue;
+
+        samples.resize(sample_count + 1);
+        for (int i = 0; i < sample_count; i++) samples[i] = m_curves[channel].evaluate(i / m_sample_rate, m_duration);
+        samples[sample_count] = samples[0];
+    }
+}
+
+void AnimationClip::sample(AnimationChannel channel, const float* times, float* out, size_t count) const
+{
+    const float* samples = m_samples[channel].data();
+    const int last = (int)m_samples[channel].size() - 2;
+    const float rate = m_sample_rate;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        float position = times[i] * rate;
+        int index = (int)position;
+        if (index > last) index = last;
+
+        float blend = position - (float)index;
+        out[i] = samples[index] + (samples[index + 1] - samples[index]) * blend;
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// how a key blends towards the next one
+enum Interpolation { INTERPOLATION_LINEAR, INTERPOLATION_EASE_IN_OUT, INTERPOLATION_CATMULL_ROM };
+
+struct Keyframe
+{
+    float time;
+    float value;
+    Interpolation interpolation;
+};
+
+// one float channel of a looping clip -- the last key blends back round to the first
+class AnimationCurve
+{
+private:
+    std::vector<Keyframe> m_keys;   // sorted by time
+
+public:
+    // keys can be added in any order
+    void add_key(float time, float value, Interpolation interpolation = INTERPOLATION_LINEAR);
+
+    // exact value at a time in [0, duration)
+    float evaluate(float time, float duration) const;
+
+    bool const is_empty() const { return m_keys.empty(); };
+};
+
+enum AnimationChannel { CHANNEL_POSITION_X, CHANNEL_POSITION_Y, CHANNEL_ROTATION, CHANNEL_SCALE, NUMBER_OF_CHANNELS };
+
+// a looping set of curves sampled by absolute time
+// bake() resamples every curve at a fixed rate, so sampling a whole crowd is an index and a lerp per
+// instance with no key searches or branches -- the cost is the same whatever the curves look like
+class AnimationClip
+{
+private:
+    float m_duration;
+    float m_sample_rate;    // per second
+    AnimationCurve m_curves[NUMBER_OF_CHANNELS];
+    std::vector<float> m_samples[NUMBER_OF_CHANNELS];  // one extra at the end, equal to the first
+
+public:
+    static const int DEFAULT_SAMPLE_RATE = 120;
+
+    AnimationClip();
+
+    void initialise(float duration, int sample_rate = DEFAULT_SAMPLE_RATE);
+    AnimationCurve& get_curve(AnimationChannel channel) { return m_curves[channel]; };
+
+    // call once every key is in
+    void bake();
+
+    // times must already be wrapped into [0, duration)
+    void sample(AnimationChannel channel, const float* times, float* out, size_t count) const;
+
+    bool const has_channel(AnimationChannel channel) const { return !m_curves[channel].is_empty(); };
+    float const get_duration() const { return m_duration; };
+};
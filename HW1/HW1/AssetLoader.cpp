@@ -0,0 +1,277 @@
+#define GL_SILENCE_DEPRECATION
+
+#include "AssetLoader.h"
+#include "TextureStreamer.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <iostream>
+
+// the game's only stb_image implementation -- 2.12 shares two globals between decodes, the failure
+// string (compiled out here, nothing reads it) and the default Huffman tables the first inflate fills
+// lazily, so those are built once up front and then any number of threads can decode at the same time
+#define STBI_NO_FAILURE_STRINGS
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+static void prepare_stb_image()
+{
+    static std::once_flag once;
+    std::call_once(once, stbi__init_zdefaults);
+}
+
+void AssetLoader::initialise(unsigned int worker_count, TextureStreamer* streamer)
+{
+    m_streamer = streamer;
+    m_stopping = false;
+    m_outstanding = 0;
+
+    // before any worker starts, so none of them race to fill the tables
+    prepare_stb_image();
+
+    // leave a core for the GL thread
+    if (worker_count == 0)
+    {
+        unsigned int cores = std::thread::hardware_concurrency();
+        worker_count = cores > 1 ? cores - 1 : 1;
+    }
+
+    for (unsigned int i = 0; i < worker_count; i++)
+    {
+        m_workers.emplace_back(&AssetLoader::worker_loop, this);
+    }
+}
+
+void AssetLoader::cleanup()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_work_available.notify_all();
+    for (std::thread& worker : m_workers) worker.join();
+    m_workers.clear();
+
+    for (Asset& asset : m_assets)
+    {
+        free_image(asset.image);
+        if (asset.texture_id == 0) continue;
+
+        // the id can be handed out again, so the streamer must not remember it as resident
+        if (m_streamer != NULL) m_streamer->release(asset.texture_id);
+        glDeleteTextures(1, &asset.texture_id);
+    }
+    m_assets.clear();
+    m_decoded.clear();
+}
+
+void AssetLoader::worker_loop()
+{
+    while (true)
+    {
+        AssetHandle handle;
+        std::string path;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_work_available.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+            if (m_stopping) return;
+
+            handle = m_queue.top().handle;
+            m_queue.pop();
+            path = m_assets[handle].path;
+        }
+
+        // the expensive part -- runs without holding the lock
+        DecodedImage image;
+        {
+            PROFILE_SCOPE("decode image");
+            image = decode_image(path);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            Asset& asset = m_assets[handle];
+            asset.image = image;
+            asset.status = image.pixels != NULL ? ASSET_DECODED : ASSET_FAILED;
+            if (image.pixels == NULL) std::cout << "Unable to load image: " << path << std::endl;
+
+            m_decoded.push_back(handle);
+            m_outstanding--;
+        }
+        m_work_done.notify_all();
+    }
+}
+
+AssetHandle AssetLoader::request_texture(const std::string& path, int priority)
+{
+    AssetHandle handle;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        handle = m_assets.size();
+
+        Asset asset = { path, priority, ASSET_QUEUED, { path, 0, 0, NULL }, 0 };
+        m_assets.push_back(asset);
+        m_queue.push({ handle, priority });
+        m_outstanding++;
+    }
+    m_work_available.notify_one();
+    return handle;
+}
+
+void AssetLoader::upload(Asset& asset)
+{
+    if (m_streamer != NULL)
+    {
+        // the streamer owns the pixels from here on
+        asset.texture_id = m_streamer->enqueue(asset.image);
+        asset.image.pixels = NULL;
+        asset.status = ASSET_READY;
+        return;
+    }
+
+    asset.texture_id = upload_texture(asset.image.pixels, asset.image.width, asset.image.height, m_texture_options);
+
+    free_image(asset.image);
+    asset.status = ASSET_READY;
+}
+
+int AssetLoader::upload_decoded(int max_uploads)
+{
+    PROFILE_SCOPE("AssetLoader::upload_decoded");
+    // take the finished decodes so the workers are never blocked on a GL upload
+    std::vector<AssetHandle> ready;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        size_t count = m_decoded.size();
+        if (max_uploads >= 0 && (size_t)max_uploads < count) count = (size_t)max_uploads;
+
+        ready.assign(m_decoded.begin(), m_decoded.begin() + count);
+        m_decoded.erase(m_decoded.begin(), m_decoded.begin() + count);
+    }
+
+    int uploaded = 0;
+    for (AssetHandle handle : ready)
+    {
+        // the asset record itself is only touched by workers before it reaches m_decoded
+        Asset& asset = m_assets[handle];
+        if (asset.status != ASSET_DECODED) continue;
+
+        upload(asset);
+        uploaded++;
+    }
+    return uploaded;
+}
+
+void AssetLoader::wait_for_priority(int priority)
+{
+    while (true)
+    {
+        upload_decoded();
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        bool pending = false;
+        for (const Asset& asset : m_assets)
+        {
+            if (asset.priority <= priority && (asset.status == ASSET_QUEUED || asset.status == ASSET_DECODED))
+            {
+                pending = true;
+                break;
+            }
+        }
+        if (!pending) break;
+
+        // nothing decoded yet -- sleep until a worker finishes something
+        if (m_decoded.empty()) m_work_done.wait(lock, [this] { return !m_decoded.empty(); });
+    }
+
+    if (m_streamer == NULL) return;
+
+    // streamed textures are only usable once resident -- finish them synchronously rather than
+    // spinning on update(), which makes no progress if the staging buffer cannot be mapped
+    std::vector<GLuint> textures;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const Asset& asset : m_assets)
+        {
+            if (asset.priority <= priority && asset.texture_id != 0) textures.push_back(asset.texture_id);
+        }
+    }
+    for (GLuint texture_id : textures)
+    {
+        m_streamer->finish(texture_id);
+    }
+}
+
+std::vector<DecodedImage> AssetLoader::decode_all(const std::vector<std::string>& paths)
+{
+    std::vector<AssetHandle> handles;
+    for (const std::string& path : paths) handles.push_back(request_texture(path, ASSET_PRIORITY_HIGH));
+
+    std::vector<DecodedImage> images;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (AssetHandle handle : handles)
+    {
+        m_work_done.wait(lock, [this, handle] { return m_assets[handle].status != ASSET_QUEUED; });
+
+        // hand the pixels to the caller and retire the request so upload_decoded() skips it
+        Asset& asset = m_assets[handle];
+        images.push_back(asset.image);
+        asset.image.pixels = NULL;
+        if (asset.status == ASSET_DECODED) asset.status = ASSET_READY;
+    }
+    for (AssetHandle handle : handles)
+    {
+        m_decoded.erase(std::remove(m_decoded.begin(), m_decoded.end(), handle), m_decoded.end());
+    }
+    return images;
+}
+
+DecodedImage AssetLoader::decode_image(const std::string& path)
+{
+    DecodedImage image = { path, 0, 0, NULL };
+    int number_of_components;
+
+    prepare_stb_image();
+    image.pixels = stbi_load(path.c_str(), &image.width, &image.height, &number_of_components, STBI_rgb_alpha);
+    return image;
+}
+
+bool AssetLoader::read_image_size(const std::string& path, int& width, int& height)
+{
+    int number_of_components;
+
+    prepare_stb_image();
+    return stbi_info(path.c_str(), &width, &height, &number_of_components) != 0;
+}
+
+void AssetLoader::free_image(DecodedImage& image)
+{
+    if (image.pixels != NULL) stbi_image_free(image.pixels);
+    image.pixels = NULL;
+}
+
+AssetStatus AssetLoader::get_status(AssetHandle handle)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_assets[handle].status;
+}
+
+// zero until the texture has been fully uploaded
+GLuint AssetLoader::get_texture(AssetHandle handle)
+{
+    GLuint texture_id;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        texture_id = m_assets[handle].texture_id;
+    }
+
+    if (texture_id != 0 && m_streamer != NULL && !m_streamer->is_resident(texture_id)) return 0;
+    return texture_id;
+}
+
+bool AssetLoader::is_idle()
+{
+    if (m_streamer != NULL && !m_streamer->is_idle()) return false;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_outstanding == 0 && m_decoded.empty();
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#ifdef _WINDOWS
+#include <GL/glew.h>
+#endif
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL_opengl.h>
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+#include "TextureUpload.h"
+
+// pixels decoded by a worker -- RGBA, owned by whoever takes it out of the loader
+struct DecodedImage
+{
+    std::string path;
+    int width, height;
+    unsigned char* pixels; // NULL when the decode failed
+};
+
+// lower numbers are decoded first
+enum AssetPriority { ASSET_PRIORITY_HIGH = 0, ASSET_PRIORITY_NORMAL = 1, ASSET_PRIORITY_LOW = 2 };
+
+enum AssetStatus { ASSET_QUEUED, ASSET_DECODED, ASSET_READY, ASSET_FAILED };
+
+typedef size_t AssetHandle;
+
+class TextureStreamer;
+
+// decodes images on a pool of worker threads and uploads them on the GL thread
+// the first frame can render as soon as the high priority assets are in while the rest stream in
+class AssetLoader
+{
+private:
+    struct Request
+    {
+        AssetHandle handle;
+        int priority;
+
+        // earliest request first within a priority
+        bool operator<(const Request& other) const
+        {
+            if (priority != other.priority) return priority > other.priority;
+            return handle > other.handle;
+        }
+    };
+
+    struct Asset
+    {
+        std::string path;
+        int priority;
+        AssetStatus status;
+        DecodedImage image;
+        GLuint texture_id;
+    };
+
+    void worker_loop();
+    void upload(Asset& asset);
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_work_available;
+    std::condition_variable m_work_done;
+    bool m_stopping;
+
+    std::priority_queue<Request> m_queue;
+    std::vector<Asset> m_assets;           // indexed by handle -- guarded by m_mutex
+    std::vector<AssetHandle> m_decoded;    // waiting for the GL thread
+    size_t m_outstanding;                  // queued or decoding
+
+    TextureStreamer* m_streamer;           // NULL uploads each texture in one go
+    TextureOptions m_texture_options;      // only used without a streamer
+
+public:
+    // pass a TextureStreamer to spread uploads over several frames instead of one glTexImage2D
+    void initialise(unsigned int worker_count = 0, TextureStreamer* streamer = NULL);
+    void cleanup();
+
+    void set_texture_options(const TextureOptions& options) { m_texture_options = options; };
+
+    AssetHandle request_texture(const std::string& path, int priority = ASSET_PRIORITY_NORMAL);
+
+    // GL thread only -- uploads decoded images, at most max_uploads of them (negative for no limit)
+    int upload_decoded(int max_uploads = -1);
+
+    // GL thread only -- blocks until every asset at or above the priority is uploaded
+    void wait_for_priority(int priority);
+
+    // decodes the paths across the workers and blocks until all are done -- for callers that repack pixels
+    std::vector<DecodedImage> decode_all(const std::vector<std::string>& paths);
+
+    // any thread, concurrently -- the only way the game calls stb_image
+    static DecodedImage decode_image(const std::string& path);
+    static bool read_image_size(const std::string& path, int& width, int& height);
+    static void free_image(DecodedImage& image);
+
+    AssetStatus get_status(AssetHandle handle);
+    GLuint get_texture(AssetHandle handle);
+    bool is_idle();
+};
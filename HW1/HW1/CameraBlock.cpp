@@ -0,0 +1,35 @@
+#define GL_SILENCE_DEPRECATION
+
+#include "CameraBlock.h"
+
+void CameraBlock::initialise()
+{
+    m_has_data = false;
+
+    glGenBuffers(1, &m_ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraBlockData), NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    // attached once -- programs pick it up through glUniformBlockBinding in ShaderProgram::load
+    glBindBufferBase(GL_UNIFORM_BUFFER, CAMERA_BLOCK_BINDING, m_ubo);
+}
+
+void CameraBlock::cleanup()
+{
+    glDeleteBuffers(1, &m_ubo);
+}
+
+// uploads the camera only when it actually moved
+void CameraBlock::update(const glm::mat4& view_matrix, const glm::mat4& projection_matrix)
+{
+    if (m_has_data && m_data.view_matrix == view_matrix && m_data.projection_matrix == projection_matrix) return;
+
+    m_data.view_matrix = view_matrix;
+    m_data.projection_matrix = projection_matrix;
+    m_has_data = true;
+
+    glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CameraBlockData), &m_data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
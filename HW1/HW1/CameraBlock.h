@@ -0,0 +1,36 @@
+#pragma once
+
+#ifdef _WINDOWS
+#include <GL/glew.h>
+#endif
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL_opengl.h>
+#include "glm/mat4x4.hpp"
+
+// uniform buffer binding point every program's Camera block is attached to
+const GLuint CAMERA_BLOCK_BINDING = 0;
+
+// std140 layout of the Camera block in the *_ubo.glsl shaders -- two mat4s need no padding
+struct CameraBlockData
+{
+    glm::mat4 view_matrix;
+    glm::mat4 projection_matrix;
+};
+
+// holds the view and projection matrices in one uniform buffer shared by every program
+// moving the camera is a single upload no matter how many shader programs exist
+class CameraBlock
+{
+private:
+    GLuint m_ubo;
+    CameraBlockData m_data;
+    bool m_has_data;
+
+public:
+    void initialise();
+    void cleanup();
+
+    void update(const glm::mat4& view_matrix, const glm::mat4& projection_matrix);
+
+    GLuint const get_buffer_id() const { return m_ubo; };
+};
@@ -0,0 +1,398 @@
+#include "Collision.h"
+#include "Profiler.h"
+#include "Simd.h"
+#include "glm/geometric.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace
+{
+    const glm::uint32 MAX_END = 0x80000000u;
+    const glm::uint32 ID_MASK = 0x7FFFFFFFu;
+
+    // positive floats already order like their bits once the sign bit is set, negative ones order backwards
+    // so all their bits are flipped -- adding zero first turns -0 into 0 so the two still tie
+    glm::uint32 sortable_bits(float value)
+    {
+        value += 0.0f;
+        glm::uint32 bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+    }
+
+    glm::uint64 make_endpoint(float value, glm::uint32 end)
+    {
+        return ((glm::uint64)sortable_bits(value) << 32) | end;
+    }
+
+    int get_endpoint_id(glm::uint64 endpoint)     { return (int)(endpoint & ID_MASK); }
+    bool is_max_end(glm::uint64 endpoint)         { return (endpoint & MAX_END) != 0; }
+
+    // separating axis test on one shape's two edge normals
+    bool separated_on_edges(const glm::vec2* a, const glm::vec2* b)
+    {
+        for (int edge = 0; edge < 2; edge++)
+        {
+            glm::vec2 direction = a[edge + 1] - a[edge];
+            glm::vec2 axis = glm::vec2(-direction.y, direction.x);
+
+            float a_min = glm::dot(axis, a[0]), a_max = a_min;
+            float b_min = glm::dot(axis, b[0]), b_max = b_min;
+            for (int corner = 1; corner < 4; corner++)
+            {
+                float a_value = glm::dot(axis, a[corner]), b_value = glm::dot(axis, b[corner]);
+                a_min = glm::min(a_min, a_value); a_max = glm::max(a_max, a_value);
+                b_min = glm::min(b_min, b_value); b_max = glm::max(b_max, b_value);
+            }
+            if (a_max < b_min || b_max < a_min) return true;
+        }
+        return false;
+    }
+
+    template <typename T>
+    void fit(std::vector<T>& values, int id, const T& fill)
+    {
+        if ((size_t)id >= values.size()) values.resize(id + 1, fill);
+    }
+}
+
+void BroadPhase::initialise()
+{
+    clear();
+}
+
+void BroadPhase::clear()
+{
+    for (int axis = 0; axis < 2; axis++)
+    {
+        m_endpoints[axis].clear();
+        m_intervals[axis].clear();
+        m_last_intervals[axis].clear();
+    }
+    m_present.clear();
+    m_open_min_y.clear();
+    m_open_max_y.clear();
+    m_open_ids.clear();
+    m_open_slots.clear();
+    m_pairs.clear();
+    m_pair_slots.clear();
+    m_added = 0;
+}
+
+void BroadPhase::add(int id, const CullBounds& bounds)
+{
+    Interval empty = { 0.0f, 0.0f };
+    fit(m_intervals[0], id, empty);
+    fit(m_intervals[1], id, empty);
+    fit(m_present, id, (unsigned char)0);
+    fit(m_open_slots, id, -1);
+    assert(!m_present[id]);
+
+    m_present[id] = 1;
+    move(id, bounds);
+
+    // appended past everything, so while the insertion sort walks them into place they start out
+    // overlapping nothing and pick up their pairs from the swaps like any other move
+    for (int axis = 0; axis < 2; axis++)
+    {
+        m_endpoints[axis].push_back(make_endpoint(m_intervals[axis][id].min, (glm::uint32)id));
+        m_endpoints[axis].push_back(make_endpoint(m_intervals[axis][id].max, (glm::uint32)id | MAX_END));
+    }
+    m_added += 2;
+}
+
+void BroadPhase::move(int id, const CullBounds& bounds)
+{
+    for (int axis = 0; axis < 2; axis++)
+    {
+        Interval& interval = m_intervals[axis][id];
+        interval.min = bounds.centre[axis] - bounds.half_size[axis];
+        interval.max = bounds.centre[axis] + bounds.half_size[axis];
+    }
+}
+
+// rare, so the endpoints and pairs are compacted straight away rather than tracked
+void BroadPhase::remove(int id)
+{
+    if ((size_t)id >= m_present.size() || !m_present[id]) return;
+
+    m_present[id] = 0;
+    for (int axis = 0; axis < 2; axis++)
+    {
+        m_endpoints[axis].erase(std::remove_if(m_endpoints[axis].begin(), m_endpoints[axis].end(),
+            [id](Endpoint endpoint) { return get_endpoint_id(endpoint) == id; }), m_endpoints[axis].end());
+    }
+
+    for (size_t i = 0; i < m_pairs.size(); )
+    {
+        if (get_pair_first(m_pairs[i]) == id || get_pair_second(m_pairs[i]) == id) remove_pair(get_pair_first(m_pairs[i]), get_pair_second(m_pairs[i]));
+        else i++;
+    }
+}
+
+// inclusive on both axes, matching a min sorting ahead of a max at the same value
+bool BroadPhase::overlap(const std::vector<Interval>* intervals, int a, int b)
+{
+    const Interval& a_x = intervals[0][a];
+    const Interval& b_x = intervals[0][b];
+    const Interval& a_y = intervals[1][a];
+    const Interval& b_y = intervals[1][b];
+    return a_x.min <= b_x.max && b_x.min <= a_x.max && a_y.min <= b_y.max && b_y.min <= a_y.max;
+}
+
+bool BroadPhase::overlaps(int a, int b) const
+{
+    return overlap(m_intervals, a, b);
+}
+
+// exactly the pairs in the list -- far cheaper to test than looking the pair up, and most of the
+// ends a sort passes belong to boxes that never met
+bool BroadPhase::overlapped(int a, int b) const
+{
+    return (size_t)a < m_last_intervals[0].size() && (size_t)b < m_last_intervals[0].size() && overlap(m_last_intervals, a, b);
+}
+
+// both axes can report the same pair starting in one update, so adding is idempotent
+void BroadPhase::add_pair(int a, int b)
+{
+    glm::uint64 key = make_pair_key(a, b);
+    if (!m_pair_slots.emplace(key, m_pairs.size()).second) return;
+    m_pairs.push_back(key);
+}
+
+// swaps the last pair into the leaving one's place
+void BroadPhase::remove_pair(int a, int b)
+{
+    auto found = m_pair_slots.find(make_pair_key(a, b));
+    if (found == m_pair_slots.end()) return;
+
+    const size_t slot = found->second;
+    m_pair_slots.erase(found);
+    if (slot + 1 != m_pairs.size())
+    {
+        m_pairs[slot] = m_pairs.back();
+        m_pair_slots[m_pairs[slot]] = slot;
+    }
+    m_pairs.pop_back();
+}
+
+// an insertion sort on last step's order -- every endpoint only shuffles past the few it overtook
+// a min passing a max on its way down is where two intervals start to overlap on this axis, so the boxes
+// are checked on both axes then -- a max passing a min is where they stop, which always ends the pair
+void BroadPhase::sort_axis(int axis)
+{
+    std::vector<Endpoint>& endpoints = m_endpoints[axis];
+    const Interval* intervals = m_intervals[axis].data();
+
+    for (Endpoint& endpoint : endpoints)
+    {
+        const glm::uint32 end = (glm::uint32)endpoint;
+        const Interval& interval = intervals[end & ID_MASK];
+        endpoint = make_endpoint((end & MAX_END) ? interval.max : interval.min, end);
+    }
+
+    for (size_t i = 1; i < endpoints.size(); i++)
+    {
+        // nearly everything is still in order
+        const Endpoint endpoint = endpoints[i];
+        if (endpoints[i - 1] <= endpoint) continue;
+
+        const int id = get_endpoint_id(endpoint);
+        const bool is_max = is_max_end(endpoint);
+
+        size_t j = i;
+        for (; j > 0 && endpoint < endpoints[j - 1]; j--)
+        {
+            const Endpoint passed = endpoints[j - 1];
+            const bool passed_max = is_max_end(passed);
+            const int other = get_endpoint_id(passed);
+
+            if (!is_max && passed_max)
+            {
+                if (overlaps(id, other)) add_pair(id, other);
+            }
+            else if (is_max && !passed_max)
+            {
+                if (overlapped(id, other)) remove_pair(id, other);
+            }
+            endpoints[j] = passed;
+        }
+        endpoints[j] = endpoint;
+    }
+}
+
+// a full sort and a sweep along x, for the first update and after big batches of adds
+// where walking every new endpoint down from the end would cost more than starting over
+void BroadPhase::rebuild()
+{
+    for (int axis = 0; axis < 2; axis++)
+    {
+        const Interval* intervals = m_intervals[axis].data();
+        for (Endpoint& endpoint : m_endpoints[axis])
+        {
+            const glm::uint32 end = (glm::uint32)endpoint;
+            const Interval& interval = intervals[end & ID_MASK];
+            endpoint = make_endpoint((end & MAX_END) ? interval.max : interval.min, end);
+        }
+        std::sort(m_endpoints[axis].begin(), m_endpoints[axis].end());
+    }
+
+    // every box opening on x is checked on y against the ones already open
+    m_pairs.clear();
+    m_pair_slots.clear();
+    m_open_min_y.clear();
+    m_open_max_y.clear();
+    m_open_ids.clear();
+    for (Endpoint endpoint : m_endpoints[0])
+    {
+        const int id = get_endpoint_id(endpoint);
+
+        if (is_max_end(endpoint))
+        {
+            // swap the last open box into the leaving one's place
+            const int slot = m_open_slots[id];
+            m_open_min_y[slot] = m_open_min_y.back();
+            m_open_max_y[slot] = m_open_max_y.back();
+            m_open_ids[slot] = m_open_ids.back();
+            m_open_slots[m_open_ids[slot]] = slot;
+            m_open_min_y.pop_back();
+            m_open_max_y.pop_back();
+            m_open_ids.pop_back();
+            continue;
+        }
+
+        const float min_y = m_intervals[1][id].min, max_y = m_intervals[1][id].max;
+        const size_t open_count = m_open_ids.size();
+        size_t k = 0;
+
+#if HAS_SSE2
+        const __m128 low = _mm_set1_ps(min_y);
+        const __m128 high = _mm_set1_ps(max_y);
+        for (; k + 4 <= open_count; k += 4)
+        {
+            __m128 overlap = _mm_and_ps(_mm_cmple_ps(low, _mm_loadu_ps(&m_open_max_y[k])), _mm_cmple_ps(_mm_loadu_ps(&m_open_min_y[k]), high));
+            int mask = _mm_movemask_ps(overlap);
+            for (int lane = 0; mask != 0; lane++, mask >>= 1)
+            {
+                if (mask & 1) add_pair(id, m_open_ids[k + lane]);
+            }
+        }
+#endif
+
+        for (; k < open_count; k++)
+        {
+            if (min_y <= m_open_max_y[k] && m_open_min_y[k] <= max_y) add_pair(id, m_open_ids[k]);
+        }
+
+        m_open_slots[id] = (int)open_count;
+        m_open_min_y.push_back(min_y);
+        m_open_max_y.push_back(max_y);
+        m_open_ids.push_back(id);
+    }
+}
+
+void BroadPhase::update()
+{
+    PROFILE_SCOPE("BroadPhase::update");
+    if (m_added * 8 > m_endpoints[0].size()) rebuild();
+    else
+    {
+        sort_axis(0);
+        sort_axis(1);
+    }
+    m_added = 0;
+
+    m_last_intervals[0] = m_intervals[0];
+    m_last_intervals[1] = m_intervals[1];
+}
+
+void CollisionWorld::initialise()
+{
+    m_broad_phase.initialise();
+    clear();
+}
+
+void CollisionWorld::clear()
+{
+    m_broad_phase.clear();
+    m_shapes.clear();
+    m_contacts.clear();
+    m_previous_contacts.clear();
+    m_events.clear();
+}
+
+void CollisionWorld::set_shape(int id, const glm::mat4& model_matrix, float half_extent)
+{
+    Shape shape;
+    shape.corners[0] = glm::vec2(model_matrix * glm::vec4(-half_extent, -half_extent, 0.0f, 1.0f));
+    shape.corners[1] = glm::vec2(model_matrix * glm::vec4(half_extent, -half_extent, 0.0f, 1.0f));
+    shape.corners[2] = glm::vec2(model_matrix * glm::vec4(half_extent, half_extent, 0.0f, 1.0f));
+    shape.corners[3] = glm::vec2(model_matrix * glm::vec4(-half_extent, half_extent, 0.0f, 1.0f));
+
+    fit(m_shapes, id, shape);
+    m_shapes[id] = shape;
+}
+
+void CollisionWorld::add(int id, const glm::mat4& model_matrix, float half_extent)
+{
+    set_shape(id, model_matrix, half_extent);
+    m_broad_phase.add(id, quad_bounds(model_matrix, half_extent));
+}
+
+void CollisionWorld::move(int id, const glm::mat4& model_matrix, float half_extent)
+{
+    set_shape(id, model_matrix, half_extent);
+    m_broad_phase.move(id, quad_bounds(model_matrix, half_extent));
+}
+
+void CollisionWorld::remove(int id)
+{
+    m_broad_phase.remove(id);
+}
+
+void CollisionWorld::step()
+{
+    PROFILE_SCOPE("CollisionWorld::step");
+    m_broad_phase.update();
+
+    m_previous_contacts.swap(m_contacts);
+    m_contacts.clear();
+    for (glm::uint64 pair : m_broad_phase.get_pairs())
+    {
+        const glm::vec2* a = m_shapes[get_pair_first(pair)].corners;
+        const glm::vec2* b = m_shapes[get_pair_second(pair)].corners;
+        if (!separated_on_edges(a, b) && !separated_on_edges(b, a)) m_contacts.push_back(pair);
+    }
+
+    // the broad phase keeps its pairs in no order, and the merge below needs them sorted
+    std::sort(m_contacts.begin(), m_contacts.end());
+
+    // merge the two sorted lists -- only in this step is an enter, only in the last is an exit
+    m_events.clear();
+    size_t current = 0, previous = 0;
+    while (current < m_contacts.size() || previous < m_previous_contacts.size())
+    {
+        glm::uint64 pair;
+        CollisionEventType type;
+        if (previous == m_previous_contacts.size() || (current < m_contacts.size() && m_contacts[current] < m_previous_contacts[previous]))
+        {
+            pair = m_contacts[current++];
+            type = COLLISION_ENTER;
+        }
+        else if (current == m_contacts.size() || m_previous_contacts[previous] < m_contacts[current])
+        {
+            pair = m_previous_contacts[previous++];
+            type = COLLISION_EXIT;
+        }
+        else
+        {
+            current++;
+            previous++;
+            continue;
+        }
+
+        CollisionEvent event = { type, get_pair_first(pair), get_pair_second(pair) };
+        m_events.push_back(event);
+    }
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+#include "glm/mat4x4.hpp"
+#include "glm/vec2.hpp"
+#include "glm/gtc/type_precision.hpp"
+#include "Culling.h"
+
+// a pair of ids packed smaller first, so sorted pair lists can be merged and compared directly
+inline glm::uint64 make_pair_key(int a, int b)
+{
+    if (a > b) { int swap = a; a = b; b = swap; }
+    return ((glm::uint64)(glm::uint32)a << 32) | (glm::uint32)b;
+}
+
+inline int get_pair_first(glm::uint64 key)  { return (int)(key >> 32); }
+inline int get_pair_second(glm::uint64 key) { return (int)(key & 0xFFFFFFFFu); }
+
+// incremental sort and sweep on both axes
+// the endpoint lists are kept from one update to the next, and since things barely move between steps
+// an insertion sort puts them back in order in close to one pass -- every swap it makes is a change in
+// how two boxes relate on that axis, so the pair list is patched from the swaps instead of rebuilt
+class BroadPhase
+{
+private:
+    // one end of a box on one axis packed into a single integer that sorts the way the ends should --
+    // the value, remapped so its bits order like the float, above the id with a flag for the max end on
+    // top, so at equal values every min comes before every max and touching boxes count as overlapping
+    typedef glm::uint64 Endpoint;
+
+    struct Interval
+    {
+        float min, max;
+    };
+
+    std::vector<Endpoint> m_endpoints[2];
+    std::vector<Interval> m_intervals[2];   // per axis by id, so refreshing an axis only touches that axis
+    std::vector<Interval> m_last_intervals[2];  // as of the last update, when the pair list was exact
+    std::vector<unsigned char> m_present;
+    size_t m_added;             // endpoints appended since the last update
+
+    // boxes whose x interval the rebuild sweep is inside, with their y intervals copied alongside so the scan
+    // reads three flat arrays and compares four boxes at a time
+    std::vector<float> m_open_min_y;
+    std::vector<float> m_open_max_y;
+    std::vector<int> m_open_ids;
+    std::vector<int> m_open_slots;          // per id, where it sits in m_open
+
+    std::vector<glm::uint64> m_pairs;       // in no particular order
+    std::unordered_map<glm::uint64, size_t> m_pair_slots;
+
+    static bool overlap(const std::vector<Interval>* intervals, int a, int b);
+    bool overlaps(int a, int b) const;
+    bool overlapped(int a, int b) const;
+    void add_pair(int a, int b);
+    void remove_pair(int a, int b);
+    void sort_axis(int axis);
+    void rebuild();
+
+public:
+    void initialise();
+    void clear();
+
+    void add(int id, const CullBounds& bounds);
+    void move(int id, const CullBounds& bounds);
+    void remove(int id);
+
+    // re-sorts the endpoints and brings the list of overlapping boxes up to date
+    // after a big batch of adds everything is sorted and swept from scratch instead
+    void update();
+
+    const std::vector<glm::uint64>& get_pairs()      const { return m_pairs; };
+};
+
+enum CollisionEventType { COLLISION_ENTER, COLLISION_EXIT };
+
+struct CollisionEvent
+{
+    CollisionEventType type;
+    int first;
+    int second;
+};
+
+// sprites as the parallelograms they are drawn as -- the broad phase works on their boxes,
+// the narrow phase on the shapes themselves, and contacts are compared with the previous step
+// to report which pairs started and stopped touching
+class CollisionWorld
+{
+private:
+    struct Shape
+    {
+        glm::vec2 corners[4];   // in SpriteBatch order
+    };
+
+    BroadPhase m_broad_phase;
+    std::vector<Shape> m_shapes;
+    std::vector<glm::uint64> m_contacts;            // sorted
+    std::vector<glm::uint64> m_previous_contacts;
+    std::vector<CollisionEvent> m_events;
+
+    void set_shape(int id, const glm::mat4& model_matrix, float half_extent);
+
+public:
+    void initialise();
+    void clear();
+
+    // a flat square of the given half extent carried by the model matrix
+    void add(int id, const glm::mat4& model_matrix, float half_extent);
+    void move(int id, const glm::mat4& model_matrix, float half_extent);
+    void remove(int id);
+
+    // finds this step's contacts and the enter/exit events against the last step
+    void step();
+
+    const std::vector<glm::uint64>& get_contacts()      const { return m_contacts; };
+    const std::vector<CollisionEvent>& get_events()     const { return m_events; };
+    size_t const get_candidate_count()                  const { return m_broad_phase.get_pairs().size(); };
+};
@@ -0,0 +1,82 @@
+#include "Culling.h"
+#include "Simd.h"
+#include "glm/common.hpp"
+#include "glm/matrix.hpp"
+
+CullBounds view_bounds(const glm::mat4& projection_matrix, const glm::mat4& view_matrix)
+{
+    glm::mat4 inverse = glm::inverse(projection_matrix * view_matrix);
+    glm::vec2 low = glm::vec2(inverse * glm::vec4(-1.0f, -1.0f, 0.0f, 1.0f));
+    glm::vec2 high = glm::vec2(inverse * glm::vec4(1.0f, 1.0f, 0.0f, 1.0f));
+
+    // a flipped camera still gives a positive half size
+    CullBounds bounds;
+    bounds.centre = (low + high) * 0.5f;
+    bounds.half_size = glm::abs(high - low) * 0.5f;
+    return bounds;
+}
+
+CullBounds quad_bounds(const glm::mat4& model_matrix, float half_extent)
+{
+    // each corner is origin +- x axis +- y axis, so the widest reach along an axis is the sum of the absolute terms
+    const glm::mat4& m = model_matrix;
+    CullBounds bounds;
+    bounds.centre = glm::vec2(m[3]);
+    bounds.half_size = glm::vec2(glm::abs(m[0].x) + glm::abs(m[1].x), glm::abs(m[0].y) + glm::abs(m[1].y)) * half_extent;
+    return bounds;
+}
+
+bool is_visible(const CullBounds& bounds, const CullBounds& view)
+{
+    glm::vec2 distance = glm::abs(bounds.centre - view.centre);
+    glm::vec2 reach = bounds.half_size + view.half_size;
+    return distance.x <= reach.x && distance.y <= reach.y;
+}
+
+size_t cull_quads(const glm::mat4* model_matrices, size_t count, float half_extent, const CullBounds& view, unsigned char* visible)
+{
+    size_t visible_count = 0;
+    size_t i = 0;
+
+#if HAS_SSE2
+    // four boxes per step -- the matrices are gathered into lanes, x and y tested side by side
+    const __m128 view_x = _mm_set1_ps(view.centre.x);
+    const __m128 view_y = _mm_set1_ps(view.centre.y);
+    const __m128 view_half_x = _mm_set1_ps(view.half_size.x);
+    const __m128 view_half_y = _mm_set1_ps(view.half_size.y);
+    const __m128 extent = _mm_set1_ps(half_extent);
+
+    for (; i + 4 <= count; i += 4)
+    {
+        const glm::mat4* m = &model_matrices[i];
+
+        __m128 x_axis_x = abs_ps(_mm_setr_ps(m[0][0].x, m[1][0].x, m[2][0].x, m[3][0].x));
+        __m128 x_axis_y = abs_ps(_mm_setr_ps(m[0][0].y, m[1][0].y, m[2][0].y, m[3][0].y));
+        __m128 y_axis_x = abs_ps(_mm_setr_ps(m[0][1].x, m[1][1].x, m[2][1].x, m[3][1].x));
+        __m128 y_axis_y = abs_ps(_mm_setr_ps(m[0][1].y, m[1][1].y, m[2][1].y, m[3][1].y));
+        __m128 centre_x = _mm_setr_ps(m[0][3].x, m[1][3].x, m[2][3].x, m[3][3].x);
+        __m128 centre_y = _mm_setr_ps(m[0][3].y, m[1][3].y, m[2][3].y, m[3][3].y);
+
+        __m128 reach_x = _mm_add_ps(_mm_mul_ps(_mm_add_ps(x_axis_x, y_axis_x), extent), view_half_x);
+        __m128 reach_y = _mm_add_ps(_mm_mul_ps(_mm_add_ps(x_axis_y, y_axis_y), extent), view_half_y);
+        __m128 distance_x = abs_ps(_mm_sub_ps(centre_x, view_x));
+        __m128 distance_y = abs_ps(_mm_sub_ps(centre_y, view_y));
+
+        int mask = _mm_movemask_ps(_mm_and_ps(_mm_cmple_ps(distance_x, reach_x), _mm_cmple_ps(distance_y, reach_y)));
+        for (int lane = 0; lane < 4; lane++)
+        {
+            unsigned char inside = (unsigned char)((mask >> lane) & 1);
+            visible[i + lane] = inside;
+            visible_count += inside;
+        }
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        visible[i] = is_visible(quad_bounds(model_matrices[i], half_extent), view) ? 1 : 0;
+        visible_count += visible[i];
+    }
+
+    return visible_count;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "glm/mat4x4.hpp"
+#include "glm/vec2.hpp"
+
+// a world space axis-aligned box kept as centre and half size -- the overlap test is then one abs and one compare per axis
+struct CullBounds
+{
+    glm::vec2 centre;
+    glm::vec2 half_size;
+};
+
+// the world space rectangle an orthographic camera sees -- the clip space square mapped back through the camera
+CullBounds view_bounds(const glm::mat4& projection_matrix, const glm::mat4& view_matrix);
+
+// the box around a flat square of the given half extent once it has been through the model matrix
+CullBounds quad_bounds(const glm::mat4& model_matrix, float half_extent);
+
+bool is_visible(const CullBounds& bounds, const CullBounds& view);
+
+// writes 1 for every quad that overlaps the view and 0 for the rest, returns how many are visible
+// four boxes are tested per step on SSE2, any remainder goes through the scalar test
+size_t cull_quads(const glm::mat4* model_matrices, size_t count, float half_extent, const CullBounds& view, unsigned char* visible);
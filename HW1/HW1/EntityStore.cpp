@@ -0,0 +1,270 @@
+#include "EntityStore.h"
+#include "JobSystem.h"
+#include "Animation.h"
+#include "glm/gtc/matrix_transform.hpp"
+#include <atomic>
+#include <cassert>
+#include <cmath>
+
+const int EntityStore::NO_PARENT;
+const int EntityStore::NO_ANIMATION;
+const size_t EntityStore::SAMPLE_BLOCK;
+const size_t EntityStore::CHUNK_SIZE;
+
+EntityStore::EntityStore() : m_world_updates(0), m_jobs(NULL) {}
+
+// each chunk only writes its own entities, so no pass needs a lock
+void EntityStore::for_each_chunk(const std::function<void(size_t, size_t)>& body) const
+{
+    for_each_chunk(m_parents.size(), body);
+}
+
+void EntityStore::for_each_chunk(size_t count, const std::function<void(size_t, size_t)>& body) const
+{
+    if (m_jobs != NULL) m_jobs->parallel_for(count, CHUNK_SIZE, body);
+    else if (count > 0) body(0, count);
+}
+
+void EntityStore::reserve(size_t count)
+{
+    m_positions.reserve(count);
+    m_rotations.reserve(count);
+    m_scales.reserve(count);
+    m_parents.reserve(count);
+    m_depths.reserve(count);
+    m_rest_positions.reserve(count);
+    m_rest_rotations.reserve(count);
+    m_rest_scales.reserve(count);
+    m_animations.reserve(count);
+    m_animation_offsets.reserve(count);
+    m_textures.reserve(count);
+    m_uv_rects.reserve(count);
+    m_local_matrices.reserve(count);
+    m_world_matrices.reserve(count);
+    m_previous_world_matrices.reserve(count);
+    m_local_dirty.reserve(count);
+    m_world_changed.reserve(count);
+}
+
+void EntityStore::clear()
+{
+    m_positions.clear();
+    m_rotations.clear();
+    m_scales.clear();
+    m_parents.clear();
+    m_depths.clear();
+    m_depth_entities.clear();
+    m_rest_positions.clear();
+    m_rest_rotations.clear();
+    m_rest_scales.clear();
+    m_animations.clear();
+    m_animation_offsets.clear();
+    m_clips.clear();
+    m_textures.clear();
+    m_uv_rects.clear();
+    m_local_matrices.clear();
+    m_world_matrices.clear();
+    m_previous_world_matrices.clear();
+    m_local_dirty.clear();
+    m_world_changed.clear();
+    m_world_updates = 0;
+}
+
+int EntityStore::create(const glm::vec2& position, float rotation, const glm::vec2& scale, int parent)
+{
+    int entity = (int)m_parents.size();
+    assert(parent < entity);
+
+    m_positions.push_back(position);
+    m_rotations.push_back(rotation);
+    m_scales.push_back(scale);
+    m_parents.push_back(parent);
+
+    int depth = parent == NO_PARENT ? 0 : m_depths[parent] + 1;
+    m_depths.push_back(depth);
+
+    // depths never change after creation, so the buckets are only ever appended to
+    if (depth >= (int)m_depth_entities.size()) m_depth_entities.resize(depth + 1);
+    m_depth_entities[depth].push_back(entity);
+
+    m_rest_positions.push_back(position);
+    m_rest_rotations.push_back(rotation);
+    m_rest_scales.push_back(scale);
+    m_animations.push_back(NO_ANIMATION);
+    m_animation_offsets.push_back(0.0f);
+
+    m_textures.push_back(0);
+    m_uv_rects.push_back(glm::vec4(0.0f, 0.0f, 1.0f, 1.0f));
+
+    m_local_matrices.push_back(glm::mat4(1.0f));
+    m_world_matrices.push_back(glm::mat4(1.0f));
+    m_previous_world_matrices.push_back(glm::mat4(1.0f));
+    m_local_dirty.push_back(1);
+    m_world_changed.push_back(0);
+    return entity;
+}
+
+void EntityStore::set_position(int entity, const glm::vec2& position)
+{
+    m_positions[entity] = m_rest_positions[entity] = position;
+    m_local_dirty[entity] = 1;
+}
+
+void EntityStore::set_rotation(int entity, float rotation)
+{
+    m_rotations[entity] = m_rest_rotations[entity] = rotation;
+    m_local_dirty[entity] = 1;
+}
+
+void EntityStore::set_scale(int entity, const glm::vec2& scale)
+{
+    m_scales[entity] = m_rest_scales[entity] = scale;
+    m_local_dirty[entity] = 1;
+}
+
+int EntityStore::add_clip(const AnimationClip* clip)
+{
+    m_clips.push_back(clip);
+    return (int)m_clips.size() - 1;
+}
+
+void EntityStore::set_animation(int entity, int clip, float time_offset)
+{
+    m_animations[entity] = clip;
+    m_animation_offsets[entity] = time_offset;
+
+    // back to the rest pose when the animation is taken away
+    m_positions[entity] = m_rest_positions[entity];
+    m_rotations[entity] = m_rest_rotations[entity];
+    m_scales[entity] = m_rest_scales[entity];
+    m_local_dirty[entity] = 1;
+}
+
+void EntityStore::set_sprite(int entity, GLuint texture_id, const glm::vec4& uv_rect)
+{
+    m_textures[entity] = texture_id;
+    m_uv_rects[entity] = uv_rect;
+}
+
+// entities sharing a clip are sampled a block at a time, one channel at a time,
+// so each inner loop is the same arithmetic over contiguous floats
+void EntityStore::animate(double time)
+{
+    for_each_chunk([this, time](size_t begin, size_t end)
+    {
+        float times[SAMPLE_BLOCK];
+        float values[SAMPLE_BLOCK];
+
+        size_t first = begin;
+        while (first < end)
+        {
+            // the longest run of one clip that fits in a block
+            int animation = m_animations[first];
+            size_t last = first + 1;
+            while (last < end && last - first < SAMPLE_BLOCK && m_animations[last] == animation) last++;
+
+            if (animation == NO_ANIMATION)
+            {
+                first = last;
+                continue;
+            }
+
+            const AnimationClip& clip = *m_clips[animation];
+            const double duration = clip.get_duration();
+            const size_t count = last - first;
+
+            for (size_t i = 0; i < count; i++)
+            {
+                double local = std::fmod(time + m_animation_offsets[first + i], duration);
+                times[i] = (float)(local < 0.0 ? local + duration : local);
+            }
+
+            if (clip.has_channel(CHANNEL_POSITION_X))
+            {
+                clip.sample(CHANNEL_POSITION_X, times, values, count);
+                for (size_t i = 0; i < count; i++) m_positions[first + i].x = m_rest_positions[first + i].x + values[i];
+            }
+            if (clip.has_channel(CHANNEL_POSITION_Y))
+            {
+                clip.sample(CHANNEL_POSITION_Y, times, values, count);
+                for (size_t i = 0; i < count; i++) m_positions[first + i].y = m_rest_positions[first + i].y + values[i];
+            }
+            if (clip.has_channel(CHANNEL_ROTATION))
+            {
+                clip.sample(CHANNEL_ROTATION, times, values, count);
+                for (size_t i = 0; i < count; i++) m_rotations[first + i] = m_rest_rotations[first + i] + values[i];
+            }
+            if (clip.has_channel(CHANNEL_SCALE))
+            {
+                clip.sample(CHANNEL_SCALE, times, values, count);
+                for (size_t i = 0; i < count; i++) m_scales[first + i] = m_rest_scales[first + i] * values[i];
+            }
+
+            for (size_t i = first; i < last; i++) m_local_dirty[i] = 1;
+            first = last;
+        }
+    });
+}
+
+void EntityStore::update_world_matrices()
+{
+    std::atomic<size_t> updates(0);
+
+    for (const std::vector<int>& entities : m_depth_entities)
+    {
+        for_each_chunk(entities.size(), [this, &entities, &updates](size_t begin, size_t end)
+        {
+            size_t chunk_updates = 0;
+            for (size_t slot = begin; slot < end; slot++)
+            {
+                const int i = entities[slot];
+
+                // the parent sits one depth up, so its flag was settled by the previous pass
+                int parent = m_parents[i];
+                bool parent_changed = parent != NO_PARENT && m_world_changed[parent];
+
+                m_world_changed[i] = m_local_dirty[i] || parent_changed;
+                if (!m_world_changed[i]) continue;
+
+                if (m_local_dirty[i])
+                {
+                    glm::mat4 local = glm::translate(glm::mat4(1.0f), glm::vec3(m_positions[i], 0.0f));
+                    local = glm::rotate(local, m_rotations[i], glm::vec3(0.0f, 0.0f, 1.0f));
+                    m_local_matrices[i] = glm::scale(local, glm::vec3(m_scales[i], 1.0f));
+                    m_local_dirty[i] = 0;
+                }
+
+                m_world_matrices[i] = parent == NO_PARENT ? m_local_matrices[i] : m_world_matrices[parent] * m_local_matrices[i];
+                chunk_updates++;
+            }
+            updates += chunk_updates;
+        });
+    }
+
+    m_world_updates = updates;
+}
+
+// everything else already matches -- it was copied the last time it moved
+void EntityStore::save_previous()
+{
+    for_each_chunk([this](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            if (m_world_changed[i]) m_previous_world_matrices[i] = m_world_matrices[i];
+        }
+    });
+}
+
+void EntityStore::interpolate(float alpha, std::vector<glm::mat4>& out) const
+{
+    out.resize(m_parents.size());
+    for_each_chunk([this, alpha, &out](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            const glm::mat4& previous = m_previous_world_matrices[i];
+            out[i] = previous + (m_world_matrices[i] - previous) * alpha;
+        }
+    });
+}
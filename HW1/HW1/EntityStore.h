@@ -0,0 +1,115 @@
+#pragma once
+
+#ifdef _WINDOWS
+#include <GL/glew.h>
+#endif
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL_opengl.h>
+#include <functional>
+#include <vector>
+#include "glm/mat4x4.hpp"
+#include "glm/vec2.hpp"
+#include "glm/vec4.hpp"
+
+class JobSystem;
+class AnimationClip;
+
+// every sprite in the scene, stored as parallel arrays indexed by entity
+// each pass touches only the components it needs and walks them front to back,
+// so animating and transforming many sprites stays in cache instead of chasing pointers
+// entities form a transform hierarchy -- a matrix is only rebuilt when its own TRS or an ancestor's changed
+class EntityStore
+{
+private:
+    // transform -- relative to the parent, rotation in radians
+    std::vector<glm::vec2> m_positions;
+    std::vector<float> m_rotations;
+    std::vector<glm::vec2> m_scales;
+    std::vector<int> m_parents;
+    std::vector<int> m_depths;      // 0 for roots
+    std::vector<std::vector<int>> m_depth_entities; // entities at each depth, in creation order
+
+    // animation -- the clip's curves are applied on top of the rest pose
+    // positions and rotations are added to it, scale multiplies it
+    std::vector<glm::vec2> m_rest_positions;
+    std::vector<float> m_rest_rotations;
+    std::vector<glm::vec2> m_rest_scales;
+    std::vector<int> m_animations;          // index into m_clips or NO_ANIMATION
+    std::vector<float> m_animation_offsets; // seconds, so copies of a clip need not move in lockstep
+    std::vector<const AnimationClip*> m_clips;
+
+    // what to draw
+    std::vector<GLuint> m_textures;
+    std::vector<glm::vec4> m_uv_rects;
+
+    // cached by update_world_matrices() -- unsigned char rather than bool so the flags are plain bytes
+    std::vector<glm::mat4> m_local_matrices;
+    std::vector<glm::mat4> m_world_matrices;
+    std::vector<glm::mat4> m_previous_world_matrices;
+    std::vector<unsigned char> m_local_dirty;
+    std::vector<unsigned char> m_world_changed;  // during the last update_world_matrices()
+
+    size_t m_world_updates;
+
+    JobSystem* m_jobs;
+
+    void for_each_chunk(const std::function<void(size_t, size_t)>& body) const;
+    void for_each_chunk(size_t count, const std::function<void(size_t, size_t)>& body) const;
+
+public:
+    static const int NO_PARENT = -1;
+    static const int NO_ANIMATION = -1;
+
+    // instances sampled together on the stack during animate()
+    static const size_t SAMPLE_BLOCK = 256;
+
+    // entities per job when the passes are split across threads
+    static const size_t CHUNK_SIZE = 2048;
+
+    EntityStore();
+
+    // NULL runs every pass on the calling thread
+    void set_job_system(JobSystem* jobs) { m_jobs = jobs; };
+
+    void reserve(size_t count);
+    void clear();
+
+    // parents must already exist, so a single front-to-back pass always sees a parent before its children
+    int create(const glm::vec2& position, float rotation, const glm::vec2& scale, int parent = NO_PARENT);
+
+    // each sets the rest pose and marks the entity dirty -- its world matrix and its children's are rebuilt on the next update
+    void set_position(int entity, const glm::vec2& position);
+    void set_rotation(int entity, float rotation);
+    void set_scale(int entity, const glm::vec2& scale);
+
+    // clips must be baked and outlive the store
+    int add_clip(const AnimationClip* clip);
+
+    // entities without an animation are left alone by animate(), so a still part costs nothing per step
+    void set_animation(int entity, int clip, float time_offset = 0.0f);
+    void set_sprite(int entity, GLuint texture_id, const glm::vec4& uv_rect);
+
+    // samples every animated entity's clip at an absolute time in seconds
+    // nothing is integrated, so the animation can never drift however long it runs
+    void animate(double time);
+
+    // local = translate * rotate * scale, world = parent world * local
+    // skips every entity whose local TRS and ancestors are unchanged
+    // runs one pass per hierarchy depth, so every parent is finished before any chunk reads it
+    // each pass only walks the entities at its depth, so the total work stays O(N) however deep the tree
+    void update_world_matrices();
+
+    // keeps this step's world matrices so render can blend between them and the next
+    // only the entities that moved in the last update are copied
+    void save_previous();
+    void interpolate(float alpha, std::vector<glm::mat4>& out) const;
+
+    size_t const get_count()                          const { return m_parents.size(); };
+    size_t const get_world_updates()                  const { return m_world_updates; };
+    const std::vector<glm::mat4>& get_world_matrices()  const { return m_world_matrices; };
+    const std::vector<glm::mat4>& get_previous_world_matrices() const { return m_previous_world_matrices; };
+    const std::vector<float>& get_animation_offsets()   const { return m_animation_offsets; };
+    const std::vector<int>& get_parents()               const { return m_parents; };
+    const std::vector<GLuint>& get_textures()           const { return m_textures; };
+    const std::vector<glm::vec4>& get_uv_rects()        const { return m_uv_rects; };
+};
@@ -0,0 +1,228 @@
+#include "FileWatcher.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WINDOWS
+#include <sys/types.h>
+#endif
+#include <sys/stat.h>
+
+const int FileWatcher::DEFAULT_POLL_INTERVAL_MS;
+
+namespace
+{
+    // -1 when the file cannot be read right now -- an editor halfway through replacing it, say
+    long long get_modified_time(const std::string& path)
+    {
+#ifdef _WINDOWS
+        struct _stat info;
+        if (_stat(path.c_str(), &info) != 0) return -1;
+#else
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0) return -1;
+#endif
+        return (long long)info.st_mtime;
+    }
+}
+
+void FileWatcher::initialise(int poll_interval_ms)
+{
+    m_stopping = false;
+    m_poll_interval_ms = poll_interval_ms;
+    m_inotify = -1;
+
+#ifdef __linux__
+    m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotify < 0) std::cout << "inotify unavailable, polling watched files instead" << std::endl;
+#endif
+
+    m_thread = std::thread(&FileWatcher::watch_loop, this);
+}
+
+void FileWatcher::cleanup()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_thread.join();
+
+#ifdef __linux__
+    if (m_inotify >= 0) close(m_inotify);
+#endif
+    m_inotify = -1;
+
+    for (ChangedFile& file : m_changed) AssetLoader::free_image(file.image);
+    m_changed.clear();
+    m_files.clear();
+    m_watch_descriptors.clear();
+    m_watch_directories.clear();
+}
+
+void FileWatcher::watch(const std::string& path, WatchKind kind)
+{
+    size_t slash = path.find_last_of("/\\");
+    WatchedFile file;
+    file.path = path;
+    file.directory = slash == std::string::npos ? "." : path.substr(0, slash);
+    file.name = slash == std::string::npos ? path : path.substr(slash + 1);
+    file.kind = kind;
+    file.modified_time = get_modified_time(path);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const WatchedFile& watched : m_files)
+    {
+        if (watched.path == path) return;
+    }
+    m_files.push_back(file);
+
+#ifdef __linux__
+    // editors often save by writing a new file and renaming it over the old one, which would drop a
+    // watch on the file itself -- so the directory is watched and events are matched by name
+    if (m_inotify < 0) return;
+    if (std::find(m_watch_directories.begin(), m_watch_directories.end(), file.directory) != m_watch_directories.end()) return;
+
+    int descriptor = inotify_add_watch(m_inotify, file.directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (descriptor < 0)
+    {
+        std::cout << "Unable to watch " << file.directory << std::endl;
+        return;
+    }
+    m_watch_descriptors.push_back(descriptor);
+    m_watch_directories.push_back(file.directory);
+#endif
+}
+
+void FileWatcher::collect(std::vector<ChangedFile>& out)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (ChangedFile& file : m_changed) out.push_back(file);
+    m_changed.clear();
+}
+
+void FileWatcher::watch_loop()
+{
+    while (true)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_stopping) return;
+        }
+
+        if (m_inotify >= 0)
+        {
+            read_events();
+        }
+        else
+        {
+            poll_files();
+            std::this_thread::sleep_for(std::chrono::milliseconds(m_poll_interval_ms));
+        }
+    }
+}
+
+// waits up to one poll interval for events, so cleanup() is never kept waiting longer than that
+void FileWatcher::read_events()
+{
+#ifdef __linux__
+    pollfd descriptor = { m_inotify, POLLIN, 0 };
+    if (poll(&descriptor, 1, m_poll_interval_ms) <= 0) return;
+
+    // several saves in a row only need one reload per file
+    std::vector<WatchedFile> changed;
+    alignas(inotify_event) char buffer[4096];
+    ssize_t length;
+    while ((length = read(m_inotify, buffer, sizeof(buffer))) > 0)
+    {
+        for (char* cursor = buffer; cursor < buffer + length; cursor += sizeof(inotify_event) + ((inotify_event*)cursor)->len)
+        {
+            const inotify_event* event = (const inotify_event*)cursor;
+            if (event->len == 0) continue;
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (size_t i = 0; i < m_watch_descriptors.size(); i++)
+            {
+                if (m_watch_descriptors[i] != event->wd) continue;
+
+                for (const WatchedFile& file : m_files)
+                {
+                    if (file.directory != m_watch_directories[i] || file.name != event->name) continue;
+
+                    bool seen = false;
+                    for (const WatchedFile& pending : changed) seen = seen || pending.path == file.path;
+                    if (!seen) changed.push_back(file);
+                }
+            }
+        }
+    }
+
+    for (const WatchedFile& file : changed) load_file(file);
+#endif
+}
+
+void FileWatcher::poll_files()
+{
+    std::vector<WatchedFile> changed;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (WatchedFile& file : m_files)
+        {
+            long long modified_time = get_modified_time(file.path);
+            if (modified_time < 0 || modified_time == file.modified_time) continue;
+
+            file.modified_time = modified_time;
+            changed.push_back(file);
+        }
+    }
+
+    for (const WatchedFile& file : changed) load_file(file);
+}
+
+// the expensive part -- reading and decoding happen here, on the watcher thread
+void FileWatcher::load_file(const WatchedFile& file)
+{
+    PROFILE_SCOPE("reload file");
+    ChangedFile result;
+    result.path = file.path;
+    result.kind = file.kind;
+    result.image.path = file.path;
+    result.image.width = 0;
+    result.image.height = 0;
+    result.image.pixels = NULL;
+
+    if (file.kind == WATCH_SHADER)
+    {
+        std::ifstream infile(file.path);
+        if (infile.fail()) return;
+
+        std::stringstream buffer;
+        buffer << infile.rdbuf();
+        result.source = buffer.str();
+    }
+    else
+    {
+        // shares the loader's lock -- stb_image is not safe to run on two threads at once
+        result.image = AssetLoader::decode_image(file.path);
+    }
+
+    // a newer version replaces one the GL thread has not picked up yet
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (ChangedFile& pending : m_changed)
+    {
+        if (pending.path != result.path) continue;
+        AssetLoader::free_image(pending.image);
+        pending = result;
+        return;
+    }
+    m_changed.push_back(result);
+}
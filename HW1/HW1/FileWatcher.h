@@ -0,0 +1,65 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "AssetLoader.h"
+
+enum WatchKind { WATCH_SHADER, WATCH_IMAGE };
+
+// a watched file that changed on disk, already read or decoded -- owned by whoever collects it
+struct ChangedFile
+{
+    std::string path;
+    WatchKind kind;
+    std::string source;     // WATCH_SHADER
+    DecodedImage image;     // WATCH_IMAGE, pixels NULL when the decode failed
+};
+
+// notices edits to watched files and loads the new contents on its own thread,
+// so the GL thread only has to upload or relink what changed
+// inotify on Linux wakes it the moment an editor closes or renames the file into place,
+// anywhere else it polls modification times
+class FileWatcher
+{
+private:
+    struct WatchedFile
+    {
+        std::string path;
+        std::string directory;
+        std::string name;
+        WatchKind kind;
+        long long modified_time;    // polling only
+    };
+
+    void watch_loop();
+    void poll_files();
+    void read_events();
+    void load_file(const WatchedFile& file);
+
+    std::thread m_thread;
+    std::mutex m_mutex;
+    bool m_stopping;                    // guarded by m_mutex
+    int m_poll_interval_ms;
+
+    std::vector<WatchedFile> m_files;   // guarded by m_mutex
+    std::vector<ChangedFile> m_changed; // guarded by m_mutex, newest version of each path only
+
+    int m_inotify;                      // -1 when polling
+    std::vector<int> m_watch_descriptors;
+    std::vector<std::string> m_watch_directories;
+
+public:
+    static const int DEFAULT_POLL_INTERVAL_MS = 250;
+
+    void initialise(int poll_interval_ms = DEFAULT_POLL_INTERVAL_MS);
+    void cleanup();
+
+    void watch(const std::string& path, WatchKind kind);
+
+    // hands over everything that changed since the last call
+    void collect(std::vector<ChangedFile>& out);
+
+    bool const is_using_inotify() const { return m_inotify >= 0; };
+};
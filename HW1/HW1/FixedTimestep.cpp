@@ -0,0 +1,35 @@
+#include "FixedTimestep.h"
+
+void FixedTimestep::initialise(double step_seconds, int max_steps_per_frame)
+{
+    m_frequency = SDL_GetPerformanceFrequency();
+    m_step_seconds = step_seconds;
+    m_step_ticks = (Uint64)(step_seconds * (double)m_frequency + 0.5);
+    if (m_step_ticks == 0) m_step_ticks = 1;
+
+    m_max_steps_per_frame = max_steps_per_frame;
+    m_previous_counter = SDL_GetPerformanceCounter();
+    m_accumulator = 0;
+    m_total_steps = 0;
+    m_dropped_steps = 0;
+}
+
+int FixedTimestep::advance()
+{
+    Uint64 counter = SDL_GetPerformanceCounter();
+    m_accumulator += counter - m_previous_counter;
+    m_previous_counter = counter;
+
+    Uint64 steps = m_accumulator / m_step_ticks;
+    m_accumulator -= steps * m_step_ticks;
+
+    // spiral of death clamp
+    if (steps > (Uint64)m_max_steps_per_frame)
+    {
+        m_dropped_steps += steps - m_max_steps_per_frame;
+        steps = m_max_steps_per_frame;
+    }
+
+    m_total_steps += steps;
+    return (int)steps;
+}
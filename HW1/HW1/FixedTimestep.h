@@ -0,0 +1,34 @@
+#pragma once
+
+#include <SDL.h>
+
+// drives the simulation at a fixed rate off SDL's high resolution counter
+// every frame the real elapsed time is added to an accumulator and consumed in whole steps,
+// what is left over becomes the blend factor for interpolating the rendered state
+class FixedTimestep
+{
+private:
+    Uint64 m_frequency;
+    Uint64 m_previous_counter;
+    Uint64 m_accumulator;       // in counter ticks so no float error builds up
+    Uint64 m_step_ticks;
+
+    double m_step_seconds;
+    int m_max_steps_per_frame;
+
+    Uint64 m_total_steps;
+    Uint64 m_dropped_steps;
+
+public:
+    void initialise(double step_seconds, int max_steps_per_frame);
+
+    // how many simulation steps to run this frame -- never more than max_steps_per_frame,
+    // anything beyond that is dropped so a slow frame cannot snowball into a slower one
+    int advance();
+
+    // 0 right after a step, approaching 1 just before the next one
+    float const get_alpha()            const { return (float)((double)m_accumulator / (double)m_step_ticks); };
+    float const get_step_seconds()     const { return (float)m_step_seconds; };
+    Uint64 const get_total_steps()     const { return m_total_steps; };
+    Uint64 const get_dropped_steps()   const { return m_dropped_steps; };
+};
@@ -0,0 +1,84 @@
+#include "FrameHistogram.h"
+#include <cstdio>
+
+FrameHistogram::FrameHistogram()
+{
+    reset();
+}
+
+void FrameHistogram::reset()
+{
+    // the first SUB_BUCKETS values are exact, then each power of two adds SUB_BUCKETS >> 1 buckets
+    m_counts.assign((size_t)(POWER_BUCKETS + 1) * (SUB_BUCKETS >> 1), 0);
+    m_total_count = 0;
+    m_max = 0;
+    m_min = UINT64_MAX;
+    m_sum = 0.0;
+}
+
+// values below SUB_BUCKETS are stored exactly, above that each power of two
+// range keeps only the top SUB_BUCKET_BITS bits of the value
+size_t FrameHistogram::get_index(uint64_t value) const
+{
+    if (value < (uint64_t)SUB_BUCKETS) return (size_t)value;
+
+    int highest_bit = 63;
+    while (!(value >> highest_bit)) highest_bit--;
+
+    int power = highest_bit - SUB_BUCKET_BITS + 1;
+    uint64_t sub_bucket = (value >> power) - (SUB_BUCKETS >> 1);
+    return (size_t)power * (SUB_BUCKETS >> 1) + (SUB_BUCKETS >> 1) + (size_t)sub_bucket;
+}
+
+// largest value that maps to the index
+uint64_t FrameHistogram::get_value(size_t index) const
+{
+    if (index < (size_t)SUB_BUCKETS) return index;
+
+    size_t half = SUB_BUCKETS >> 1;
+    size_t power = (index - half) / half;
+    uint64_t sub_bucket = (index - half) % half + half;
+    return ((sub_bucket + 1) << power) - 1;
+}
+
+void FrameHistogram::record(uint64_t nanoseconds)
+{
+    m_counts[get_index(nanoseconds)]++;
+    m_total_count++;
+    m_sum += (double)nanoseconds;
+    if (nanoseconds > m_max) m_max = nanoseconds;
+    if (nanoseconds < m_min) m_min = nanoseconds;
+}
+
+uint64_t FrameHistogram::get_percentile(double percentile) const
+{
+    if (m_total_count == 0) return 0;
+
+    uint64_t target = (uint64_t)(percentile / 100.0 * (double)m_total_count + 0.5);
+    if (target < 1) target = 1;
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < m_counts.size(); i++)
+    {
+        seen += m_counts[i];
+        if (seen >= target)
+        {
+            // the bucket edge can overshoot the real maximum
+            uint64_t value = get_value(i);
+            return value < m_max ? value : m_max;
+        }
+    }
+    return m_max;
+}
+
+std::string FrameHistogram::summarise(const std::string& name) const
+{
+    char line[160];
+    snprintf(line, sizeof(line), "%-8s p50 %8.3f ms   p99 %8.3f ms   max %8.3f ms   (%llu samples)",
+             name.c_str(),
+             get_percentile(50.0) / 1.0e6,
+             get_percentile(99.0) / 1.0e6,
+             get_max() / 1.0e6,
+             (unsigned long long)m_total_count);
+    return line;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// HDR-style histogram of durations in nanoseconds
+// values are bucketed by power of two and then split linearly -- each power keeps the top half of
+// SUB_BUCKETS, 64 sub-buckets, so every recorded value is within 1/64 (~1.6%) of its bucket edge
+// from a microsecond up to minutes with a fixed, small table
+class FrameHistogram
+{
+private:
+    static const int SUB_BUCKET_BITS = 7;
+    static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static const int POWER_BUCKETS = 64 - SUB_BUCKET_BITS + 1;
+
+    size_t get_index(uint64_t value) const;
+    uint64_t get_value(size_t index) const;
+
+    std::vector<uint64_t> m_counts;
+    uint64_t m_total_count;
+    uint64_t m_max;
+    uint64_t m_min;
+    double m_sum;
+
+public:
+    FrameHistogram();
+
+    void record(uint64_t nanoseconds);
+    void reset();
+
+    // upper edge of the bucket holding the given percentile (0-100)
+    uint64_t get_percentile(double percentile) const;
+
+    uint64_t const get_count() const { return m_total_count; };
+    uint64_t const get_max()   const { return m_max; };
+    uint64_t const get_min()   const { return m_total_count > 0 ? m_min : 0; };
+    double const get_mean()    const { return m_total_count > 0 ? m_sum / (double)m_total_count : 0.0; };
+
+    // "name  p50 x ms  p99 y ms  max z ms"
+    std::string summarise(const std::string& name) const;
+};
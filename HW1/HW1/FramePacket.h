@@ -0,0 +1,55 @@
+#pragma once
+
+#include <SDL.h>
+#include <atomic>
+#include <vector>
+#include "glm/mat4x4.hpp"
+
+// everything the render thread needs from one simulation step -- never written once published
+// textures are not included, they are created and assigned on the render thread anyway
+struct FramePacket
+{
+    std::vector<glm::mat4> previous_matrices;  // world matrices one step earlier, for interpolation
+    std::vector<glm::mat4> current_matrices;
+    size_t world_updates;
+    size_t contacts;                           // sprites touching after this step
+    double simulation_time;                    // of the current step, in seconds
+    Uint64 step_counter;                       // SDL performance counter when the step finished
+
+    FramePacket() : world_updates(0), contacts(0), simulation_time(0.0), step_counter(0) {}
+};
+
+// one producer, one consumer, neither ever blocks
+// the producer fills its slot and swaps it into the middle, the consumer swaps the middle out
+// when something new is there -- so the consumer always sees the newest finished value
+template <typename T>
+class TripleBuffer
+{
+private:
+    static const int FRESH = 4; // set on the middle index until the consumer takes it
+
+    T m_slots[3];
+    int m_write;                // producer only
+    int m_read;                 // consumer only
+    std::atomic<int> m_middle;
+
+public:
+    TripleBuffer() : m_write(0), m_read(1), m_middle(2) {}
+
+    T& get_write_slot() { return m_slots[m_write]; };
+
+    void publish()
+    {
+        m_write = m_middle.exchange(m_write | FRESH, std::memory_order_acq_rel) & ~FRESH;
+    }
+
+    // false means nothing new -- the read slot still holds the last value
+    bool acquire()
+    {
+        if ((m_middle.load(std::memory_order_relaxed) & FRESH) == 0) return false;
+        m_read = m_middle.exchange(m_read, std::memory_order_acq_rel) & ~FRESH;
+        return true;
+    }
+
+    const T& get_read_slot() const { return m_slots[m_read]; };
+};
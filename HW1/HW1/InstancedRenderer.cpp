@@ -0,0 +1,165 @@
+#define GL_SILENCE_DEPRECATION
+
+#include "InstancedRenderer.h"
+#include "Profiler.h"
+#include <SDL.h>
+#include <cstdio>
+
+bool InstancedRenderer::is_supported()
+{
+    // glDrawArraysInstanced is core from 3.1 and glVertexAttribDivisor from 3.3 -- anything older
+    // needs the extension for each of them
+    int major = 0, minor = 0;
+    const char* version = (const char*)glGetString(GL_VERSION);
+    if (version != NULL && sscanf(version, "%d.%d", &major, &minor) == 2 && (major > 3 || (major == 3 && minor >= 3))) return true;
+
+    return SDL_GL_ExtensionSupported("GL_ARB_draw_instanced") == SDL_TRUE &&
+           SDL_GL_ExtensionSupported("GL_ARB_instanced_arrays") == SDL_TRUE;
+}
+
+void InstancedRenderer::initialise(const ShaderProgram& program, float half_extent, size_t initial_instances)
+{
+    m_half_extent = half_extent;
+    m_draw_calls = 0;
+    m_instance_capacity = 0;
+
+    m_axes_attribute = program.get_instance_axes_attribute();
+    m_origin_attribute = program.get_instance_origin_attribute();
+    m_uv_rect_attribute = program.get_instance_uv_rect_attribute();
+
+    m_instances.reserve(initial_instances);
+    m_textures.reserve(initial_instances);
+
+    // unit quad with corner texture coordinates -- the shader scales both per instance
+    float quad_vertices[] = {
+        -1.0f, -1.0f, 0.0f, 1.0f,    1.0f, -1.0f, 1.0f, 1.0f,    1.0f, 1.0f, 1.0f, 0.0f,  // triangle 1
+        -1.0f, -1.0f, 0.0f, 1.0f,    1.0f, 1.0f, 1.0f, 0.0f,    -1.0f, 1.0f, 0.0f, 0.0f   // triangle 2
+    };
+    const GLsizei stride = 4 * sizeof(float);
+
+    glGenVertexArrays(1, &m_vao);
+    glBindVertexArray(m_vao);
+
+    glGenBuffers(1, &m_quad_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, m_quad_vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad_vertices), quad_vertices, GL_STATIC_DRAW);
+
+    glVertexAttribPointer(program.get_position_attribute(), 2, GL_FLOAT, GL_FALSE, stride, (void*)0);
+    glEnableVertexAttribArray(program.get_position_attribute());
+
+    glVertexAttribPointer(program.get_tex_coordinate_attribute(), 2, GL_FLOAT, GL_FALSE, stride, (void*)(2 * sizeof(float)));
+    glEnableVertexAttribArray(program.get_tex_coordinate_attribute());
+
+    // one step of these per instance rather than per vertex
+    glGenBuffers(1, &m_instance_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, m_instance_vbo);
+    reserve_instances(initial_instances);
+
+    glEnableVertexAttribArray(m_axes_attribute);
+    glEnableVertexAttribArray(m_origin_attribute);
+    glEnableVertexAttribArray(m_uv_rect_attribute);
+    glVertexAttribDivisor(m_axes_attribute, 1);
+    glVertexAttribDivisor(m_origin_attribute, 1);
+    glVertexAttribDivisor(m_uv_rect_attribute, 1);
+    point_instance_attributes(0);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstancedRenderer::cleanup()
+{
+    glDeleteBuffers(1, &m_instance_vbo);
+    glDeleteBuffers(1, &m_quad_vbo);
+    glDeleteVertexArrays(1, &m_vao);
+}
+
+// grows the GPU buffer -- only happens when a frame has more instances than ever before
+void InstancedRenderer::reserve_instances(size_t instance_count)
+{
+    if (instance_count <= m_instance_capacity && m_instance_capacity > 0) return;
+
+    size_t doubled = m_instance_capacity * 2;
+    m_instance_capacity = instance_count > doubled ? instance_count : doubled;
+    if (m_instance_capacity == 0) m_instance_capacity = 1;
+    glBufferData(GL_ARRAY_BUFFER, m_instance_capacity * sizeof(Instance), NULL, GL_STREAM_DRAW);
+}
+
+// without base instance support each run starts the instance attributes at its own offset
+void InstancedRenderer::point_instance_attributes(size_t first_instance)
+{
+    const size_t base = first_instance * sizeof(Instance);
+    glVertexAttribPointer(m_axes_attribute, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(base));
+    glVertexAttribPointer(m_origin_attribute, 2, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(base + 4 * sizeof(float)));
+    glVertexAttribPointer(m_uv_rect_attribute, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(base + 6 * sizeof(float)));
+}
+
+void InstancedRenderer::begin()
+{
+    m_instances.clear();
+    m_textures.clear();
+    m_draw_calls = 0;
+}
+
+void InstancedRenderer::submit(const glm::mat4& model_matrix, GLuint texture_id, const glm::vec4& uv_rect)
+{
+    // sprites are flat, so only the x and y columns plus the translation matter
+    const float e = m_half_extent;
+    Instance instance = {
+        model_matrix[0].x * e, model_matrix[0].y * e,
+        model_matrix[1].x * e, model_matrix[1].y * e,
+        model_matrix[3].x, model_matrix[3].y,
+        uv_rect.x, uv_rect.y, uv_rect.z, uv_rect.w
+    };
+    m_instances.push_back(instance);
+    m_textures.push_back(texture_id);
+}
+
+void InstancedRenderer::submit_quad(const glm::vec2* corners, GLuint texture_id, const glm::vec4& uv_rect)
+{
+    glm::vec2 x_axis = (corners[1] - corners[0]) * 0.5f;
+    glm::vec2 y_axis = (corners[3] - corners[0]) * 0.5f;
+    glm::vec2 origin = corners[0] + x_axis + y_axis;
+
+    Instance instance = {
+        x_axis.x, x_axis.y,
+        y_axis.x, y_axis.y,
+        origin.x, origin.y,
+        uv_rect.x, uv_rect.y, uv_rect.z, uv_rect.w
+    };
+    m_instances.push_back(instance);
+    m_textures.push_back(texture_id);
+}
+
+// uploads every instance in one go and draws each run that shares a texture with one call
+// submission order is kept so alpha blending still layers correctly
+void InstancedRenderer::flush(ShaderProgram& program)
+{
+    PROFILE_SCOPE("InstancedRenderer::flush");
+    if (m_instances.empty()) return;
+
+    program.bind();
+    glBindVertexArray(m_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, m_instance_vbo);
+    reserve_instances(m_instances.size());
+    glBufferSubData(GL_ARRAY_BUFFER, 0, m_instances.size() * sizeof(Instance), m_instances.data());
+
+    size_t run_start = 0;
+    while (run_start < m_instances.size())
+    {
+        GLuint texture_id = m_textures[run_start];
+        size_t run_end = run_start + 1;
+        while (run_end < m_instances.size() && m_textures[run_end] == texture_id) run_end++;
+
+        point_instance_attributes(run_start);
+        glBindTexture(GL_TEXTURE_2D, texture_id);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, VERTICES_PER_QUAD, (GLsizei)(run_end - run_start));
+        m_draw_calls++;
+
+        run_start = run_end;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    m_instances.clear();
+    m_textures.clear();
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#ifdef _WINDOWS
+#include <GL/glew.h>
+#endif
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL_opengl.h>
+#include <vector>
+#include "glm/mat4x4.hpp"
+#include "glm/vec2.hpp"
+#include "glm/vec4.hpp"
+#include "ShaderProgram.h"
+#include "SpriteBatch.h"
+
+// draws sprites as instances of one shared quad
+// each sprite is a compact 2D affine transform plus its UV rect -- 10 floats instead of SpriteBatch's
+// 6 transformed vertices -- and every run of sprites sharing a texture is a single glDrawArraysInstanced
+class InstancedRenderer
+{
+private:
+    struct Instance
+    {
+        float x_axis_x, x_axis_y;   // half extents already applied
+        float y_axis_x, y_axis_y;
+        float origin_x, origin_y;
+        float u0, v0, u1, v1;
+    };
+
+    void reserve_instances(size_t instance_count);
+    void point_instance_attributes(size_t first_instance);
+
+    std::vector<Instance> m_instances;
+    std::vector<GLuint> m_textures;     // parallel to m_instances
+
+    GLuint m_vao;
+    GLuint m_quad_vbo;
+    GLuint m_instance_vbo;
+    size_t m_instance_capacity;
+
+    GLuint m_axes_attribute;
+    GLuint m_origin_attribute;
+    GLuint m_uv_rect_attribute;
+
+    float m_half_extent;
+    int m_draw_calls;
+
+public:
+    static const int VERTICES_PER_QUAD = 6;
+
+    // needs GL_ARB_instanced_arrays or GL 3.3
+    static bool is_supported();
+
+    void initialise(const ShaderProgram& program, float half_extent, size_t initial_instances);
+    void cleanup();
+
+    void begin();
+    void submit(const glm::mat4& model_matrix, GLuint texture_id, const glm::vec4& uv_rect = FULL_UV_RECT);
+
+    // corners in SpriteBatch order -- the quad is taken as the parallelogram through the first, second and last
+    void submit_quad(const glm::vec2* corners, GLuint texture_id, const glm::vec4& uv_rect = FULL_UV_RECT);
+
+    void flush(ShaderProgram& program);
+
+    int const get_draw_calls()        const { return m_draw_calls; };
+    size_t const get_instance_count() const { return m_instances.size(); };
+};
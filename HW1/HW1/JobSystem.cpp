@@ -0,0 +1,157 @@
+#include "JobSystem.h"
+#include "Profiler.h"
+
+namespace
+{
+    // which queue the current thread owns -- -1 for threads that are not workers, which go through
+    // the injection queue so two of them never push and pop the same deque's back at once
+    thread_local int t_worker_index = -1;
+}
+
+void JobSystem::initialise(unsigned int worker_count)
+{
+    m_stopping = false;
+    m_queued = 0;
+    t_worker_index = 0;
+
+    // the main thread does its share while it waits
+    if (worker_count == 0)
+    {
+        unsigned int cores = std::thread::hardware_concurrency();
+        worker_count = cores > 1 ? cores - 1 : 0;
+    }
+
+    for (unsigned int i = 0; i <= worker_count; i++) m_queues.emplace_back(new WorkerQueue());
+    for (unsigned int i = 1; i <= worker_count; i++) m_workers.emplace_back(&JobSystem::worker_loop, this, (int)i);
+}
+
+void JobSystem::cleanup()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_sleep_mutex);
+        m_stopping = true;
+    }
+    m_work_available.notify_all();
+    for (std::thread& worker : m_workers) worker.join();
+    m_workers.clear();
+    m_queues.clear();
+    t_worker_index = -1;
+}
+
+void JobSystem::submit(const std::function<void()>& function, JobCounter& counter)
+{
+    counter.pending.fetch_add(1, std::memory_order_relaxed);
+
+    WorkerQueue& queue = t_worker_index >= 0 ? *m_queues[t_worker_index] : m_injected;
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back({ function, &counter });
+    }
+
+    // bumped under the sleep mutex so a worker deciding to sleep cannot miss it
+    {
+        std::lock_guard<std::mutex> lock(m_sleep_mutex);
+        m_queued++;
+    }
+    m_work_available.notify_one();
+}
+
+// newest first -- it is the most likely to still be in this core's cache
+bool JobSystem::pop(int worker, Job& job)
+{
+    WorkerQueue& queue = *m_queues[worker];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.jobs.empty()) return false;
+
+    job = queue.jobs.back();
+    queue.jobs.pop_back();
+    return true;
+}
+
+// oldest first -- the injection queue, then the other deques starting with the next thread along
+// so thieves do not all pile onto one victim
+bool JobSystem::steal(int thief, Job& job)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_injected.mutex);
+        if (!m_injected.jobs.empty())
+        {
+            job = m_injected.jobs.front();
+            m_injected.jobs.pop_front();
+            return true;
+        }
+    }
+
+    const int count = (int)m_queues.size();
+    for (int offset = 1; offset <= count; offset++)
+    {
+        const int victim = (thief + offset) % count;
+        if (victim == thief) continue;
+
+        WorkerQueue& queue = *m_queues[victim];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.jobs.empty()) continue;
+
+        job = queue.jobs.front();
+        queue.jobs.pop_front();
+        return true;
+    }
+    return false;
+}
+
+bool JobSystem::run_one(int worker)
+{
+    Job job;
+    if ((worker < 0 || !pop(worker, job)) && !steal(worker, job)) return false;
+    m_queued--;
+
+    {
+        PROFILE_SCOPE("job");
+        job.function();
+    }
+    job.counter->pending.fetch_sub(1, std::memory_order_release);
+    return true;
+}
+
+void JobSystem::worker_loop(int worker)
+{
+    t_worker_index = worker;
+
+    while (true)
+    {
+        if (run_one(worker)) continue;
+
+        std::unique_lock<std::mutex> lock(m_sleep_mutex);
+        m_work_available.wait(lock, [this] { return m_stopping || m_queued > 0; });
+        if (m_stopping) return;
+    }
+}
+
+void JobSystem::wait(JobCounter& counter)
+{
+    while (!counter.is_done())
+    {
+        // whatever is left is running on another thread
+        if (!run_one(t_worker_index)) std::this_thread::yield();
+    }
+}
+
+void JobSystem::parallel_for(size_t count, size_t chunk_size, const std::function<void(size_t, size_t)>& body)
+{
+    if (chunk_size == 0) chunk_size = 1;
+
+    // not worth a job
+    if (count <= chunk_size || m_workers.empty())
+    {
+        if (count > 0) body(0, count);
+        return;
+    }
+
+    JobCounter counter;
+    for (size_t begin = 0; begin < count; begin += chunk_size)
+    {
+        size_t end = begin + chunk_size < count ? begin + chunk_size : count;
+        submit([&body, begin, end] { body(begin, end); }, counter);
+    }
+    wait(counter);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// counts the jobs of a group still to finish -- wait() on it to join the group
+struct JobCounter
+{
+    std::atomic<int> pending;
+
+    JobCounter() : pending(0) {}
+    bool is_done() const { return pending.load(std::memory_order_acquire) == 0; }
+};
+
+// work-stealing job scheduler
+// every thread owns a deque -- it pushes and pops its own jobs at the back while idle threads
+// steal the oldest jobs from the front of someone else's, so work spreads without a shared queue
+// the thread that called initialise() is worker 0 and runs jobs itself whenever it waits
+// any other thread (the simulation thread) has no deque of its own and submits to a shared
+// injection queue instead, which every worker drains once its own deque is empty
+class JobSystem
+{
+private:
+    struct Job
+    {
+        std::function<void()> function;
+        JobCounter* counter;
+    };
+
+    struct WorkerQueue
+    {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    bool pop(int worker, Job& job);
+    bool steal(int thief, Job& job);
+    bool run_one(int worker);
+    void worker_loop(int worker);
+
+    std::vector<std::unique_ptr<WorkerQueue>> m_queues;  // one per thread, [0] belongs to the main thread
+    WorkerQueue m_injected;                              // jobs from threads the system does not own
+    std::vector<std::thread> m_workers;
+
+    std::mutex m_sleep_mutex;
+    std::condition_variable m_work_available;
+    std::atomic<int> m_queued;
+    bool m_stopping;
+
+public:
+    // worker_count extra threads -- 0 picks one per remaining core
+    void initialise(unsigned int worker_count = 0);
+    void cleanup();
+
+    void submit(const std::function<void()>& function, JobCounter& counter);
+
+    // runs queued jobs on the calling thread until the counter reaches zero
+    void wait(JobCounter& counter);
+
+    // calls body(begin, end) over [0, count) in chunks of chunk_size and returns once all are done
+    // the chunks never depend on which thread ran them, so the result is the same on any core count
+    void parallel_for(size_t count, size_t chunk_size, const std::function<void(size_t, size_t)>& body);
+
+    int const get_thread_count() const { return (int)m_queues.size(); };
+};
@@ -0,0 +1,78 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <vector>
+
+const size_t ProfileBuffer::CAPACITY;
+
+namespace
+{
+    std::mutex g_buffers_mutex;
+    std::vector<ProfileBuffer*> g_buffers;
+
+    // trace_event wants JSON strings -- scope names are literals, but escape them anyway
+    std::string escape(const char* text)
+    {
+        std::string result;
+        for (const char* c = text; *c; c++)
+        {
+            if (*c == '"' || *c == '\\') result += '\\';
+            result += *c;
+        }
+        return result;
+    }
+}
+
+ProfileBuffer* Profiler::create_thread_buffer()
+{
+    ProfileBuffer* buffer = new ProfileBuffer();
+    buffer->next = 0;
+
+    // off the hot path -- once per thread
+    std::lock_guard<std::mutex> lock(g_buffers_mutex);
+    buffer->thread_id = (uint32_t)g_buffers.size() + 1;
+    g_buffers.push_back(buffer);
+    return buffer;
+}
+
+bool Profiler::write_chrome_trace(const std::string& path)
+{
+    std::ofstream outfile(path, std::ios::trunc);
+    if (outfile.fail()) return false;
+
+    const double microseconds_per_tick = 1.0e6 / (double)SDL_GetPerformanceFrequency();
+
+    // timestamps are relative to the first event so the viewer starts at zero
+    Uint64 origin = UINT64_MAX;
+    std::lock_guard<std::mutex> lock(g_buffers_mutex);
+    for (ProfileBuffer* buffer : g_buffers)
+    {
+        size_t count = std::min(buffer->next, ProfileBuffer::CAPACITY);
+        for (size_t i = buffer->next - count; i < buffer->next; i++)
+        {
+            origin = std::min(origin, buffer->events[i & (ProfileBuffer::CAPACITY - 1)].start);
+        }
+    }
+
+    outfile << std::fixed << std::setprecision(3);
+    outfile << "{\"traceEvents\":[\n";
+    bool first = true;
+    for (ProfileBuffer* buffer : g_buffers)
+    {
+        size_t count = std::min(buffer->next, ProfileBuffer::CAPACITY);
+        for (size_t i = buffer->next - count; i < buffer->next; i++)
+        {
+            const ProfileEvent& event = buffer->events[i & (ProfileBuffer::CAPACITY - 1)];
+            if (!first) outfile << ",\n";
+            first = false;
+
+            outfile << "{\"name\":\"" << escape(event.name) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->thread_id
+                    << ",\"ts\":" << (event.start - origin) * microseconds_per_tick
+                    << ",\"dur\":" << (event.end - event.start) * microseconds_per_tick << "}";
+        }
+    }
+    outfile << "\n]}\n";
+    return outfile.good();
+}
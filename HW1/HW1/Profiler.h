@@ -0,0 +1,78 @@
+#pragma once
+
+#include <SDL.h>
+#include <stdint.h>
+#include <string>
+
+// set to 0 to compile every PROFILE_SCOPE out entirely
+#ifndef ENABLE_PROFILING
+#define ENABLE_PROFILING 1
+#endif
+
+struct ProfileEvent
+{
+    const char* name;   // must be a string literal -- only the pointer is stored
+    Uint64 start;
+    Uint64 end;
+};
+
+// one per thread -- written only by its owner, so recording needs no locks
+// once full, the oldest events are overwritten
+struct ProfileBuffer
+{
+    static const size_t CAPACITY = 1 << 16;
+
+    ProfileEvent events[CAPACITY];
+    size_t next;        // total events ever written
+    uint32_t thread_id;
+};
+
+class Profiler
+{
+private:
+    static ProfileBuffer* create_thread_buffer();
+
+public:
+    // the calling thread's buffer -- allocated and registered on first use only
+    static ProfileBuffer* get_thread_buffer()
+    {
+        static thread_local ProfileBuffer* buffer = NULL;
+        if (buffer == NULL) buffer = create_thread_buffer();
+        return buffer;
+    }
+
+    static void record(const char* name, Uint64 start, Uint64 end)
+    {
+        ProfileBuffer* buffer = get_thread_buffer();
+        ProfileEvent& event = buffer->events[buffer->next & (ProfileBuffer::CAPACITY - 1)];
+        event.name = name;
+        event.start = start;
+        event.end = end;
+        buffer->next++;
+    }
+
+    // writes every recorded event as Chrome trace_event JSON (open in chrome://tracing or Perfetto)
+    // call once the other threads have stopped recording
+    static bool write_chrome_trace(const std::string& path);
+};
+
+// times the enclosing scope
+class ScopedProfile
+{
+private:
+    const char* m_name;
+    Uint64 m_start;
+
+public:
+    explicit ScopedProfile(const char* name) : m_name(name), m_start(SDL_GetPerformanceCounter()) {}
+    ~ScopedProfile() { Profiler::record(m_name, m_start, SDL_GetPerformanceCounter()); }
+};
+
+#define PROFILE_CONCATENATE_INNER(a, b) a##b
+#define PROFILE_CONCATENATE(a, b) PROFILE_CONCATENATE_INNER(a, b)
+
+#if ENABLE_PROFILING
+#define PROFILE_SCOPE(name) ScopedProfile PROFILE_CONCATENATE(profile_scope_, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name)
+#endif
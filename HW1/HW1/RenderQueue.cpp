@@ -0,0 +1,107 @@
+#include "RenderQueue.h"
+#include "Profiler.h"
+#include <cassert>
+
+const int RenderQueue::LAYER_SHIFT;
+const int RenderQueue::BLEND_SHIFT;
+const int RenderQueue::OPAQUE_SHADER_SHIFT;
+const int RenderQueue::OPAQUE_TEXTURE_SHIFT;
+const int RenderQueue::BLENDED_DEPTH_SHIFT;
+const int RenderQueue::BLENDED_SHADER_SHIFT;
+
+glm::uint64 RenderQueue::make_key(int layer, BlendMode blend, int shader, GLuint texture_id, glm::uint32 depth)
+{
+    assert(layer >= 0 && layer <= 0xFF && shader >= 0 && shader <= 0x3F && texture_id <= 0xFFFFFF);
+    glm::uint64 key = ((glm::uint64)layer << LAYER_SHIFT) | ((glm::uint64)blend << BLEND_SHIFT);
+
+    if (blend == BLEND_OPAQUE)
+    {
+        return key
+             | ((glm::uint64)shader << OPAQUE_SHADER_SHIFT)
+             | ((glm::uint64)texture_id << OPAQUE_TEXTURE_SHIFT)
+             | (depth & 0xFFFFFF);
+    }
+    return key
+         | ((glm::uint64)(depth & 0xFFFFFF) << BLENDED_DEPTH_SHIFT)
+         | ((glm::uint64)shader << BLENDED_SHADER_SHIFT)
+         | texture_id;
+}
+
+int RenderQueue::get_shader(glm::uint64 key)
+{
+    int shift = get_blend(key) == BLEND_OPAQUE ? OPAQUE_SHADER_SHIFT : BLENDED_SHADER_SHIFT;
+    return (int)(key >> shift) & 0x3F;
+}
+
+GLuint RenderQueue::get_texture(glm::uint64 key)
+{
+    int shift = get_blend(key) == BLEND_OPAQUE ? OPAQUE_TEXTURE_SHIFT : 0;
+    return (GLuint)(key >> shift) & 0xFFFFFF;
+}
+
+glm::uint64 RenderQueue::get_state(glm::uint64 key)
+{
+    const glm::uint64 depth_mask = get_blend(key) == BLEND_OPAQUE ? 0xFFFFFFull : 0xFFFFFFull << BLENDED_DEPTH_SHIFT;
+    return key & ~depth_mask;
+}
+
+void RenderQueue::reserve(size_t count)
+{
+    m_commands.reserve(count);
+    m_scratch.reserve(count);
+}
+
+void RenderQueue::begin()
+{
+    m_commands.clear();
+}
+
+void RenderQueue::push(glm::uint64 key, glm::uint32 payload)
+{
+    RenderCommand command = { key, payload };
+    m_commands.push_back(command);
+}
+
+void RenderQueue::sort()
+{
+    PROFILE_SCOPE("RenderQueue::sort");
+    const size_t count = m_commands.size();
+    if (count < 2) return;
+    m_scratch.resize(count);
+
+    // every histogram in one read of the keys
+    size_t histograms[8][256] = {};
+    for (const RenderCommand& command : m_commands)
+    {
+        for (int pass = 0; pass < 8; pass++) histograms[pass][(command.key >> (pass * 8)) & 0xFF]++;
+    }
+
+    for (int pass = 0; pass < 8; pass++)
+    {
+        size_t* histogram = histograms[pass];
+        const int shift = pass * 8;
+        if (histogram[(m_commands[0].key >> shift) & 0xFF] == count) continue;
+
+        // bucket counts into starting offsets
+        size_t offset = 0;
+        for (int bucket = 0; bucket < 256; bucket++)
+        {
+            size_t bucket_count = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucket_count;
+        }
+
+        for (const RenderCommand& command : m_commands) m_scratch[histogram[(command.key >> shift) & 0xFF]++] = command;
+        m_commands.swap(m_scratch);
+    }
+}
+
+size_t RenderQueue::count_state_changes() const
+{
+    size_t changes = 0;
+    for (size_t i = 0; i < m_commands.size(); i++)
+    {
+        if (i == 0 || get_state(m_commands[i].key) != get_state(m_commands[i - 1].key)) changes++;
+    }
+    return changes;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#ifdef _WINDOWS
+#include <GL/glew.h>
+#endif
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL_opengl.h>
+#include <vector>
+#include "glm/gtc/type_precision.hpp"
+
+// opaque sorts first so blended sprites land on top of it within a layer
+// blended draws depend on what is already in the framebuffer, so they keep their depth order over their state
+enum BlendMode { BLEND_OPAQUE, BLEND_ALPHA, BLEND_ADDITIVE };
+
+// one queued draw -- the key decides the order, the payload indexes whatever the caller keeps per draw
+struct RenderCommand
+{
+    glm::uint64 key;
+    glm::uint32 payload;
+};
+
+// draws are recorded as sort keys instead of being issued straight away, then sorted so every
+// run of identical state is replayed together -- state switches follow the number of unique states,
+// not the number of draws
+// key layout, most significant first:
+//   opaque:   layer 8 bits | blend 2 bits | shader 6 bits | texture 24 bits | depth 24 bits
+//   blended:  layer 8 bits | blend 2 bits | depth 24 bits | shader 6 bits | texture 24 bits
+// for opaque draws depth only breaks ties inside a state, and submission order keeps the sort stable anyway
+// for blended draws depth is the painter's order -- only neighbours that already share a state get merged
+class RenderQueue
+{
+private:
+    std::vector<RenderCommand> m_commands;
+    std::vector<RenderCommand> m_scratch;
+
+public:
+    static const int LAYER_SHIFT = 56;
+    static const int BLEND_SHIFT = 54;
+    static const int OPAQUE_SHADER_SHIFT = 48;
+    static const int OPAQUE_TEXTURE_SHIFT = 24;
+    static const int BLENDED_DEPTH_SHIFT = 30;
+    static const int BLENDED_SHADER_SHIFT = 24;
+
+    static glm::uint64 make_key(int layer, BlendMode blend, int shader, GLuint texture_id, glm::uint32 depth);
+
+    static int get_layer(glm::uint64 key)            { return (int)(key >> LAYER_SHIFT) & 0xFF; };
+    static BlendMode get_blend(glm::uint64 key)      { return (BlendMode)((key >> BLEND_SHIFT) & 0x3); };
+    static int get_shader(glm::uint64 key);
+    static GLuint get_texture(glm::uint64 key);
+
+    // the key without its depth -- two keys with the same state replay without touching GL state
+    static glm::uint64 get_state(glm::uint64 key);
+
+    void reserve(size_t count);
+    void begin();
+    void push(glm::uint64 key, glm::uint32 payload);
+
+    // stable LSD radix sort on the keys, a byte per pass -- passes where every key shares the byte are skipped
+    void sort();
+
+    // how many times the state bits change walking the queue in its current order
+    size_t count_state_changes() const;
+
+    const std::vector<RenderCommand>& get_commands() const { return m_commands; };
+};
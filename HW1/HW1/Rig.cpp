@@ -0,0 +1,344 @@
+#include "Rig.h"
+#include "Animation.h"
+#include "Simd.h"
+#include "glm/gtc/quaternion.hpp"
+#include <cassert>
+#include <cmath>
+
+const int Rig::MAX_BONES;
+const size_t Rig::POSE_BLOCK;
+
+namespace
+{
+    // rotation about z by angle, then translation -- 2D rigs never leave the xy plane
+    glm::dualquat make_transform(float angle, const glm::vec2& translation)
+    {
+        return glm::dualquat(glm::angleAxis(angle, glm::vec3(0.0f, 0.0f, 1.0f)), glm::vec3(translation, 0.0f));
+    }
+
+#if HAS_SSE2
+    // one component of four quaternions per register
+    struct QuatLanes
+    {
+        __m128 x, y, z, w;
+    };
+
+    // glm keeps quaternions as x, y, z, w, so four loads and a transpose turn them into lanes
+    QuatLanes load_lanes(const glm::quat& a, const glm::quat& b, const glm::quat& c, const glm::quat& d)
+    {
+        QuatLanes lanes = { _mm_loadu_ps(&a.x), _mm_loadu_ps(&b.x), _mm_loadu_ps(&c.x), _mm_loadu_ps(&d.x) };
+        _MM_TRANSPOSE4_PS(lanes.x, lanes.y, lanes.z, lanes.w);
+        return lanes;
+    }
+
+    QuatLanes blend_lanes(const QuatLanes& a, const QuatLanes& b, __m128 a_weight, __m128 b_weight)
+    {
+        QuatLanes blended;
+        blended.x = _mm_add_ps(_mm_mul_ps(a.x, a_weight), _mm_mul_ps(b.x, b_weight));
+        blended.y = _mm_add_ps(_mm_mul_ps(a.y, a_weight), _mm_mul_ps(b.y, b_weight));
+        blended.z = _mm_add_ps(_mm_mul_ps(a.z, a_weight), _mm_mul_ps(b.z, b_weight));
+        blended.w = _mm_add_ps(_mm_mul_ps(a.w, a_weight), _mm_mul_ps(b.w, b_weight));
+        return blended;
+    }
+
+    __m128 dot_lanes(const QuatLanes& a, const QuatLanes& b)
+    {
+        return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y)), _mm_add_ps(_mm_mul_ps(a.z, b.z), _mm_mul_ps(a.w, b.w)));
+    }
+
+    void divide_lanes(QuatLanes& q, __m128 divisor)
+    {
+        q.x = _mm_div_ps(q.x, divisor);
+        q.y = _mm_div_ps(q.y, divisor);
+        q.z = _mm_div_ps(q.z, divisor);
+        q.w = _mm_div_ps(q.w, divisor);
+    }
+#endif
+}
+
+int Rig::add_bone(int parent, const glm::vec2& position, float rotation, float scale, const AnimationClip* clip)
+{
+    int bone = (int)m_bones.size();
+    assert(parent < bone && bone < MAX_BONES);
+
+    Bone new_bone = { parent, position, rotation, scale, clip };
+    m_bones.push_back(new_bone);
+    return bone;
+}
+
+int Rig::add_quad(int bone, float half_extent)
+{
+    int first = (int)m_mesh.positions.size();
+
+    // same corner order as SpriteBatch -- bottom left, bottom right, top right, top left
+    const glm::vec2 corners[] = {
+        glm::vec2(-half_extent, -half_extent), glm::vec2(half_extent, -half_extent),
+        glm::vec2(half_extent, half_extent), glm::vec2(-half_extent, half_extent)
+    };
+    const glm::vec2 uvs[] = { glm::vec2(0.0f, 1.0f), glm::vec2(1.0f, 1.0f), glm::vec2(1.0f, 0.0f), glm::vec2(0.0f, 0.0f) };
+
+    for (int corner = 0; corner < 4; corner++)
+    {
+        // positions are filled in by bind() once the bone's pivot is known
+        m_mesh.positions.push_back(corners[corner]);
+        m_mesh.uvs.push_back(uvs[corner]);
+        m_mesh.bones.push_back(glm::ivec2(bone, bone));
+        m_mesh.weights.push_back(glm::vec2(1.0f, 0.0f));
+    }
+
+    MeshSection section = { first, 4, 0, glm::vec4(0.0f, 0.0f, 1.0f, 1.0f) };
+    m_mesh.sections.push_back(section);
+    return (int)m_mesh.sections.size() - 1;
+}
+
+void Rig::bind()
+{
+    const int bone_count = (int)m_bones.size();
+    std::vector<float> rotations(bone_count);
+    m_inverse_bind.resize(bone_count);
+    m_bind_pivots.resize(bone_count);
+
+    for (int b = 0; b < bone_count; b++)
+    {
+        const Bone& bone = m_bones[b];
+        rotations[b] = bone.rotation;
+        m_bind_pivots[b] = bone.position;
+
+        if (bone.parent >= 0)
+        {
+            int parent = bone.parent;
+            rotations[b] += rotations[parent];
+            float c = std::cos(rotations[parent]), s = std::sin(rotations[parent]);
+            m_bind_pivots[b] = m_bind_pivots[parent] + glm::vec2(c * bone.position.x - s * bone.position.y, s * bone.position.x + c * bone.position.y);
+        }
+
+        m_inverse_bind[b] = glm::inverse(make_transform(rotations[b], m_bind_pivots[b]));
+    }
+
+    // quads were laid out around the origin, move each onto its bone
+    for (size_t v = 0; v < m_mesh.positions.size(); v += 4)
+    {
+        const int b = m_mesh.bones[v].x;
+        float c = std::cos(rotations[b]), s = std::sin(rotations[b]);
+        for (size_t corner = v; corner < v + 4; corner++)
+        {
+            glm::vec2 p = m_mesh.positions[corner];
+            m_mesh.positions[corner] = m_bind_pivots[b] + glm::vec2(c * p.x - s * p.y, s * p.x + c * p.y);
+        }
+    }
+}
+
+void Rig::set_section_sprite(int section, GLuint texture_id, const glm::vec4& uv_rect)
+{
+    MeshSection& target = m_mesh.sections[section];
+    target.texture_id = texture_id;
+    target.uv_rect = uv_rect;
+
+    const int v = target.first_vertex;
+    m_mesh.uvs[v + 0] = glm::vec2(uv_rect.x, uv_rect.w);
+    m_mesh.uvs[v + 1] = glm::vec2(uv_rect.z, uv_rect.w);
+    m_mesh.uvs[v + 2] = glm::vec2(uv_rect.z, uv_rect.y);
+    m_mesh.uvs[v + 3] = glm::vec2(uv_rect.x, uv_rect.y);
+}
+
+void Rig::pose(const double* times, size_t count, glm::dualquat* transforms, glm::vec3* pivot_scales) const
+{
+    const int bone_count = (int)m_bones.size();
+
+    // world pose of every bone for one block of instances -- in 2D the angles simply add up
+    float rotations[MAX_BONES][POSE_BLOCK];
+    glm::vec2 positions[MAX_BONES][POSE_BLOCK];
+    float scales[MAX_BONES][POSE_BLOCK];
+    float local_times[POSE_BLOCK];
+    float values[POSE_BLOCK];
+
+    for (size_t block = 0; block < count; block += POSE_BLOCK)
+    {
+        const size_t n = count - block < POSE_BLOCK ? count - block : POSE_BLOCK;
+
+        for (int b = 0; b < bone_count; b++)
+        {
+            const Bone& bone = m_bones[b];
+            float* rotation = rotations[b];
+            glm::vec2* position = positions[b];
+            float* scale = scales[b];
+
+            // local pose -- rest plus clip
+            for (size_t i = 0; i < n; i++)
+            {
+                rotation[i] = bone.rotation;
+                position[i] = bone.position;
+                scale[i] = bone.scale;
+            }
+
+            if (bone.clip != NULL)
+            {
+                const AnimationClip& clip = *bone.clip;
+                const double duration = clip.get_duration();
+                for (size_t i = 0; i < n; i++)
+                {
+                    double local = std::fmod(times[block + i], duration);
+                    local_times[i] = (float)(local < 0.0 ? local + duration : local);
+                }
+
+                if (clip.has_channel(CHANNEL_POSITION_X))
+                {
+                    clip.sample(CHANNEL_POSITION_X, local_times, values, n);
+                    for (size_t i = 0; i < n; i++) position[i].x += values[i];
+                }
+                if (clip.has_channel(CHANNEL_POSITION_Y))
+                {
+                    clip.sample(CHANNEL_POSITION_Y, local_times, values, n);
+                    for (size_t i = 0; i < n; i++) position[i].y += values[i];
+                }
+                if (clip.has_channel(CHANNEL_ROTATION))
+                {
+                    clip.sample(CHANNEL_ROTATION, local_times, values, n);
+                    for (size_t i = 0; i < n; i++) rotation[i] += values[i];
+                }
+                if (clip.has_channel(CHANNEL_SCALE))
+                {
+                    clip.sample(CHANNEL_SCALE, local_times, values, n);
+                    for (size_t i = 0; i < n; i++) scale[i] *= values[i];
+                }
+            }
+
+            // into rig space -- the parent's row is already finished
+            if (bone.parent >= 0)
+            {
+                const float* parent_rotation = rotations[bone.parent];
+                const glm::vec2* parent_position = positions[bone.parent];
+                const float* parent_scale = scales[bone.parent];
+
+                for (size_t i = 0; i < n; i++)
+                {
+                    float c = std::cos(parent_rotation[i]), s = std::sin(parent_rotation[i]);
+                    glm::vec2 offset = position[i] * parent_scale[i];
+                    position[i] = parent_position[i] + glm::vec2(c * offset.x - s * offset.y, s * offset.x + c * offset.y);
+                    rotation[i] += parent_rotation[i];
+                    scale[i] *= parent_scale[i];
+                }
+            }
+
+            // palette entry -- undo the bind pose, then apply this one
+            for (size_t i = 0; i < n; i++)
+            {
+                size_t entry = (block + i) * bone_count + b;
+                transforms[entry] = make_transform(rotation[i], position[i]) * m_inverse_bind[b];
+                pivot_scales[entry] = glm::vec3(m_bind_pivots[b], scale[i]);
+            }
+        }
+    }
+}
+
+// dual quaternion linear blending -- the blended rotation stays rigid, unlike blended matrices
+void Rig::skin(const glm::dualquat* transforms, const glm::vec3* pivot_scales, glm::vec2* out) const
+{
+    const size_t count = m_mesh.positions.size();
+    const glm::vec2* positions = m_mesh.positions.data();
+    const glm::ivec2* bones = m_mesh.bones.data();
+    const glm::vec2* weights = m_mesh.weights.data();
+    size_t v = 0;
+
+#if HAS_SSE2
+    // four vertices per step -- each lane gathers its own two bones, then the blend, the normalise,
+    // the pivot scale and the transform below are done for all four at once, as the scalar loop does them
+    const __m128 sign_bit = _mm_castsi128_ps(_mm_set1_epi32((int)0x80000000));
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 two = _mm_set1_ps(2.0f);
+
+    for (; v + 4 <= count; v += 4)
+    {
+        const glm::ivec2* b = &bones[v];
+        const glm::vec2* w = &weights[v];
+        const glm::dualquat* first[4] = { &transforms[b[0].x], &transforms[b[1].x], &transforms[b[2].x], &transforms[b[3].x] };
+        const glm::dualquat* second[4] = { &transforms[b[0].y], &transforms[b[1].y], &transforms[b[2].y], &transforms[b[3].y] };
+
+        QuatLanes first_real = load_lanes(first[0]->real, first[1]->real, first[2]->real, first[3]->real);
+        QuatLanes first_dual = load_lanes(first[0]->dual, first[1]->dual, first[2]->dual, first[3]->dual);
+        QuatLanes second_real = load_lanes(second[0]->real, second[1]->real, second[2]->real, second[3]->real);
+        QuatLanes second_dual = load_lanes(second[0]->dual, second[1]->dual, second[2]->dual, second[3]->dual);
+        __m128 first_weight = _mm_setr_ps(w[0].x, w[1].x, w[2].x, w[3].x);
+        __m128 second_weight = _mm_setr_ps(w[0].y, w[1].y, w[2].y, w[3].y);
+
+        // same hemisphere, by flipping the sign bit of the second weight where the dot is negative
+        __m128 flip = _mm_and_ps(_mm_cmplt_ps(dot_lanes(first_real, second_real), zero), sign_bit);
+        __m128 signed_weight = _mm_xor_ps(second_weight, flip);
+        QuatLanes real = blend_lanes(first_real, second_real, first_weight, signed_weight);
+        QuatLanes dual = blend_lanes(first_dual, second_dual, first_weight, signed_weight);
+
+        __m128 length = _mm_sqrt_ps(dot_lanes(real, real));
+        divide_lanes(real, length);
+        divide_lanes(dual, length);
+
+        const glm::vec3* first_pivot[4] = { &pivot_scales[b[0].x], &pivot_scales[b[1].x], &pivot_scales[b[2].x], &pivot_scales[b[3].x] };
+        const glm::vec3* second_pivot[4] = { &pivot_scales[b[0].y], &pivot_scales[b[1].y], &pivot_scales[b[2].y], &pivot_scales[b[3].y] };
+        __m128 pivot_x = _mm_add_ps(_mm_mul_ps(_mm_setr_ps(first_pivot[0]->x, first_pivot[1]->x, first_pivot[2]->x, first_pivot[3]->x), first_weight),
+                                    _mm_mul_ps(_mm_setr_ps(second_pivot[0]->x, second_pivot[1]->x, second_pivot[2]->x, second_pivot[3]->x), second_weight));
+        __m128 pivot_y = _mm_add_ps(_mm_mul_ps(_mm_setr_ps(first_pivot[0]->y, first_pivot[1]->y, first_pivot[2]->y, first_pivot[3]->y), first_weight),
+                                    _mm_mul_ps(_mm_setr_ps(second_pivot[0]->y, second_pivot[1]->y, second_pivot[2]->y, second_pivot[3]->y), second_weight));
+        __m128 scale = _mm_add_ps(_mm_mul_ps(_mm_setr_ps(first_pivot[0]->z, first_pivot[1]->z, first_pivot[2]->z, first_pivot[3]->z), first_weight),
+                                  _mm_mul_ps(_mm_setr_ps(second_pivot[0]->z, second_pivot[1]->z, second_pivot[2]->z, second_pivot[3]->z), second_weight));
+
+        // four x, y pairs split into an x and a y register
+        __m128 low = _mm_loadu_ps(&positions[v].x);
+        __m128 high = _mm_loadu_ps(&positions[v + 2].x);
+        __m128 x = _mm_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 y = _mm_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1));
+        x = _mm_add_ps(pivot_x, _mm_mul_ps(_mm_sub_ps(x, pivot_x), scale));
+        y = _mm_add_ps(pivot_y, _mm_mul_ps(_mm_sub_ps(y, pivot_y), scale));
+
+        // glm's dual quaternion times point written out for z = 0 -- p + 2 (r x (r x p + w p + d) + w d - dw r)
+        __m128 t_x = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(real.w, x), _mm_mul_ps(real.z, y)), dual.x);
+        __m128 t_y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(real.w, y), _mm_mul_ps(real.z, x)), dual.y);
+        __m128 t_z = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(real.x, y), _mm_mul_ps(real.y, x)), dual.z);
+        __m128 out_x = _mm_sub_ps(_mm_add_ps(_mm_sub_ps(_mm_mul_ps(real.y, t_z), _mm_mul_ps(real.z, t_y)), _mm_mul_ps(dual.x, real.w)), _mm_mul_ps(real.x, dual.w));
+        __m128 out_y = _mm_sub_ps(_mm_add_ps(_mm_sub_ps(_mm_mul_ps(real.z, t_x), _mm_mul_ps(real.x, t_z)), _mm_mul_ps(dual.y, real.w)), _mm_mul_ps(real.y, dual.w));
+        out_x = _mm_add_ps(_mm_mul_ps(out_x, two), x);
+        out_y = _mm_add_ps(_mm_mul_ps(out_y, two), y);
+
+        _mm_storeu_ps(&out[v].x, _mm_unpacklo_ps(out_x, out_y));
+        _mm_storeu_ps(&out[v + 2].x, _mm_unpackhi_ps(out_x, out_y));
+    }
+#endif
+
+    for (; v < count; v++)
+    {
+        const glm::dualquat& first = transforms[bones[v].x];
+        const glm::dualquat& second = transforms[bones[v].y];
+
+        // keep both in the same hemisphere so the blend takes the short way round
+        float second_weight = glm::dot(first.real, second.real) < 0.0f ? -weights[v].y : weights[v].y;
+        glm::dualquat blended = glm::normalize(first * weights[v].x + second * second_weight);
+
+        glm::vec3 pivot_scale = pivot_scales[bones[v].x] * weights[v].x + pivot_scales[bones[v].y] * weights[v].y;
+        glm::vec2 pivot = glm::vec2(pivot_scale);
+        glm::vec2 scaled = pivot + (positions[v] - pivot) * pivot_scale.z;
+
+        out[v] = glm::vec2(blended * glm::vec3(scaled, 0.0f));
+    }
+}
+
+float Rig::measure_radius(int samples) const
+{
+    double duration = 0.0;
+    for (const Bone& bone : m_bones)
+    {
+        if (bone.clip != NULL && bone.clip->get_duration() > duration) duration = bone.clip->get_duration();
+    }
+
+    const size_t bone_count = m_bones.size();
+    std::vector<glm::dualquat> transforms(bone_count);
+    std::vector<glm::vec3> pivot_scales(bone_count);
+    std::vector<glm::vec2> vertices(m_mesh.positions.size());
+
+    float radius = 0.0f;
+    for (int sample = 0; sample < samples; sample++)
+    {
+        double time = duration * sample / samples;
+        pose(&time, 1, transforms.data(), pivot_scales.data());
+        skin(transforms.data(), pivot_scales.data(), vertices.data());
+        for (const glm::vec2& vertex : vertices) radius = glm::max(radius, glm::length(vertex));
+    }
+    return radius;
+}
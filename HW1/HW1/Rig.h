@@ -0,0 +1,93 @@
+#pragma once
+
+#ifdef _WINDOWS
+#include <GL/glew.h>
+#endif
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL_opengl.h>
+#include <vector>
+#include "glm/vec2.hpp"
+#include "glm/vec3.hpp"
+#include "glm/vec4.hpp"
+
+#ifndef GLM_ENABLE_EXPERIMENTAL
+#define GLM_ENABLE_EXPERIMENTAL
+#endif
+#include "glm/gtx/dual_quaternion.hpp"
+
+class AnimationClip;
+
+// rest pose relative to the parent bone -- a clip, if any, is layered on top the same way EntityStore does it
+struct Bone
+{
+    int parent;
+    glm::vec2 position;
+    float rotation;     // radians
+    float scale;
+    const AnimationClip* clip;
+};
+
+// a run of vertices drawn with one texture -- every section is one quad
+struct MeshSection
+{
+    int first_vertex;
+    int vertex_count;
+    GLuint texture_id;
+    glm::vec4 uv_rect;
+};
+
+// bind pose geometry in rig space, stored as parallel arrays so skinning walks each one straight through
+// every vertex blends up to two bones
+struct SkinnedMesh
+{
+    std::vector<glm::vec2> positions;
+    std::vector<glm::vec2> uvs;
+    std::vector<glm::ivec2> bones;
+    std::vector<glm::vec2> weights;     // sum to 1
+    std::vector<MeshSection> sections;
+};
+
+// a bone hierarchy plus the mesh it deforms -- a multi-part character described as data
+// posing produces a palette per instance: a dual quaternion per bone for the rigid motion and,
+// since dual quaternions cannot scale, a uniform scale applied about the bone's bind pivot beforehand
+class Rig
+{
+private:
+    std::vector<Bone> m_bones;                      // parents first
+    std::vector<glm::dualquat> m_inverse_bind;      // rest pose in rig space, inverted
+    std::vector<glm::vec2> m_bind_pivots;
+    SkinnedMesh m_mesh;
+
+public:
+    // matches the arrays in the skinned vertex shader
+    static const int MAX_BONES = 16;
+
+    // instances posed together on the stack
+    static const size_t POSE_BLOCK = 64;
+
+    // parents must be added before their children
+    int add_bone(int parent, const glm::vec2& position, float rotation = 0.0f, float scale = 1.0f, const AnimationClip* clip = NULL);
+
+    // a quad of the given half extent centred on the bone's bind pivot, fully weighted to it
+    int add_quad(int bone, float half_extent);
+
+    // captures the rest pose as the bind pose -- call once every bone is in
+    void bind();
+
+    void set_section_sprite(int section, GLuint texture_id, const glm::vec4& uv_rect);
+
+    // palettes for count instances at their own absolute times, bone_count entries each
+    // bones are the outer loop and instances the inner one, so every clip is sampled over a block of times at once
+    void pose(const double* times, size_t count, glm::dualquat* transforms, glm::vec3* pivot_scales) const;
+
+    // CPU skinning of one instance -- writes every mesh vertex in rig space, four at a time on SSE2
+    void skin(const glm::dualquat* transforms, const glm::vec3* pivot_scales, glm::vec2* out) const;
+
+    // furthest any vertex gets from the rig origin, posed at samples evenly spaced times across the longest clip
+    // a rotation-free bound, so it holds whichever way the character is turned
+    float measure_radius(int samples) const;
+
+    int const get_bone_count()          const { return (int)m_bones.size(); };
+    size_t const get_vertex_count()     const { return m_mesh.positions.size(); };
+    const SkinnedMesh& get_mesh()       const { return m_mesh; };
+};
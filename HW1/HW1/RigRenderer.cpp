@@ -0,0 +1,109 @@
+#define GL_SILENCE_DEPRECATION
+
+#include "RigRenderer.h"
+
+void RigRenderer::build_vertices(const Rig& rig)
+{
+    const SkinnedMesh& mesh = rig.get_mesh();
+    const int triangle_corners[] = { 0, 1, 2, 0, 2, 3 };
+
+    m_vertices.clear();
+    for (size_t quad = 0; quad < mesh.positions.size(); quad += 4)
+    {
+        for (int corner : triangle_corners)
+        {
+            size_t v = quad + corner;
+            Vertex vertex = {
+                mesh.positions[v].x, mesh.positions[v].y,
+                mesh.uvs[v].x, mesh.uvs[v].y,
+                (float)mesh.bones[v].x, (float)mesh.bones[v].y,
+                mesh.weights[v].x, mesh.weights[v].y
+            };
+            m_vertices.push_back(vertex);
+        }
+    }
+}
+
+void RigRenderer::initialise(const ShaderProgram& program, const Rig& rig)
+{
+    build_vertices(rig);
+
+    glGenVertexArrays(1, &m_vao);
+    glBindVertexArray(m_vao);
+
+    glGenBuffers(1, &m_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(Vertex), m_vertices.data(), GL_STATIC_DRAW);
+
+    glVertexAttribPointer(program.get_position_attribute(), 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+    glEnableVertexAttribArray(program.get_position_attribute());
+
+    glVertexAttribPointer(program.get_tex_coordinate_attribute(), 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(2 * sizeof(float)));
+    glEnableVertexAttribArray(program.get_tex_coordinate_attribute());
+
+    glVertexAttribPointer(program.get_bone_indices_attribute(), 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(4 * sizeof(float)));
+    glEnableVertexAttribArray(program.get_bone_indices_attribute());
+
+    glVertexAttribPointer(program.get_bone_weights_attribute(), 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(6 * sizeof(float)));
+    glEnableVertexAttribArray(program.get_bone_weights_attribute());
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    m_real.resize(rig.get_bone_count());
+    m_dual.resize(rig.get_bone_count());
+    m_pivot_scales.resize(rig.get_bone_count());
+}
+
+void RigRenderer::cleanup()
+{
+    glDeleteBuffers(1, &m_vbo);
+    glDeleteVertexArrays(1, &m_vao);
+}
+
+void RigRenderer::update_uvs(const Rig& rig)
+{
+    build_vertices(rig);
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, m_vertices.size() * sizeof(Vertex), m_vertices.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void RigRenderer::draw(ShaderProgram& program, const Rig& rig, const glm::mat4& model_matrix, const glm::dualquat* transforms, const glm::vec3* pivot_scales)
+{
+    const int bone_count = rig.get_bone_count();
+    for (int b = 0; b < bone_count; b++)
+    {
+        const glm::quat& real = transforms[b].real;
+        const glm::quat& dual = transforms[b].dual;
+        m_real[b] = glm::vec4(real.x, real.y, real.z, real.w);
+        m_dual[b] = glm::vec4(dual.x, dual.y, dual.z, dual.w);
+        m_pivot_scales[b] = glm::vec4(pivot_scales[b], 0.0f);
+    }
+
+    program.set_model_matrix(model_matrix);
+    program.set_bone_palette(m_real.data(), m_dual.data(), m_pivot_scales.data(), bone_count);
+    glBindVertexArray(m_vao);
+
+    const std::vector<MeshSection>& sections = rig.get_mesh().sections;
+    size_t run_start = 0;
+    while (run_start < sections.size())
+    {
+        GLuint texture_id = sections[run_start].texture_id;
+        size_t run_end = run_start + 1;
+        while (run_end < sections.size() && sections[run_end].texture_id == texture_id) run_end++;
+
+        // still streaming in
+        if (texture_id != 0)
+        {
+            GLint first = sections[run_start].first_vertex / 4 * VERTICES_PER_QUAD;
+            GLint last = (sections[run_end - 1].first_vertex / 4 + 1) * VERTICES_PER_QUAD;
+
+            glBindTexture(GL_TEXTURE_2D, texture_id);
+            glDrawArrays(GL_TRIANGLES, first, last - first);
+        }
+
+        run_start = run_end;
+    }
+}
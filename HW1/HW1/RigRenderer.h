@@ -0,0 +1,48 @@
+#pragma once
+
+#ifdef _WINDOWS
+#include <GL/glew.h>
+#endif
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL_opengl.h>
+#include <vector>
+#include "glm/mat4x4.hpp"
+#include "ShaderProgram.h"
+#include "Rig.h"
+
+// GPU skinning -- the rig's bind pose mesh is uploaded once and the skinned vertex shader
+// applies each instance's palette, so posing costs a few uniform uploads instead of rewriting vertices
+class RigRenderer
+{
+private:
+    struct Vertex
+    {
+        float x, y;
+        float u, v;
+        float bone0, bone1;
+        float weight0, weight1;
+    };
+
+    void build_vertices(const Rig& rig);
+
+    GLuint m_vao;
+    GLuint m_vbo;
+    std::vector<Vertex> m_vertices;     // each mesh quad as two triangles
+
+    // staging for the palette uniforms
+    std::vector<glm::vec4> m_real;
+    std::vector<glm::vec4> m_dual;
+    std::vector<glm::vec4> m_pivot_scales;
+
+public:
+    static const int VERTICES_PER_QUAD = 6;
+
+    void initialise(const ShaderProgram& program, const Rig& rig);
+    void cleanup();
+
+    // call after Rig::set_section_sprite so the new texture coordinates reach the buffer
+    void update_uvs(const Rig& rig);
+
+    // one draw per run of sections sharing a texture -- sections still streaming in are skipped
+    void draw(ShaderProgram& program, const Rig& rig, const glm::mat4& model_matrix, const glm::dualquat* transforms, const glm::vec3* pivot_scales);
+};
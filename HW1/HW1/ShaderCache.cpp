@@ -0,0 +1,173 @@
+#define GL_SILENCE_DEPRECATION
+
+#include "ShaderCache.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#ifdef _WINDOWS
+#include <direct.h>
+#include <process.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const uint32_t CACHE_MAGIC = 0x48534231; // "HSB1"
+
+    // no driver hands back a program binary anywhere near this large -- anything bigger is a corrupt header
+    const uint64_t MAX_BINARY_LENGTH = 64ull * 1024 * 1024;
+
+    const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+    const uint64_t FNV_PRIME = 1099511628211ull;
+
+    struct CacheHeader
+    {
+        uint32_t magic;
+        uint32_t format;
+        uint64_t key;
+        uint64_t length;
+    };
+
+    // FNV-1a -- the separator keeps "ab" + "c" and "a" + "bc" from hashing the same
+    uint64_t hash_string(uint64_t hash, const char* text)
+    {
+        if (text == NULL) text = "";
+        for (const unsigned char* c = (const unsigned char*)text; *c; c++)
+        {
+            hash ^= *c;
+            hash *= FNV_PRIME;
+        }
+        hash ^= 0xff;
+        hash *= FNV_PRIME;
+        return hash;
+    }
+}
+
+void ShaderCache::initialise(const std::string& directory)
+{
+    m_directory = directory;
+    m_hits = 0;
+    m_misses = 0;
+
+    // drivers that cannot hand out binaries report zero formats
+    GLint number_of_formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &number_of_formats);
+    m_supported = number_of_formats > 0;
+}
+
+uint64_t ShaderCache::compute_key(const std::string& vertex_source, const std::string& fragment_source) const
+{
+    uint64_t hash = FNV_OFFSET_BASIS;
+    hash = hash_string(hash, vertex_source.c_str());
+    hash = hash_string(hash, fragment_source.c_str());
+    hash = hash_string(hash, (const char*)glGetString(GL_VENDOR));
+    hash = hash_string(hash, (const char*)glGetString(GL_RENDERER));
+    hash = hash_string(hash, (const char*)glGetString(GL_VERSION));
+    return hash;
+}
+
+std::string ShaderCache::get_entry_path(uint64_t key) const
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+    return m_directory + "/" + name;
+}
+
+// fails harmlessly when the directory already exists
+void ShaderCache::ensure_directory() const
+{
+#ifdef _WINDOWS
+    _mkdir(m_directory.c_str());
+#else
+    mkdir(m_directory.c_str(), 0755);
+#endif
+}
+
+bool ShaderCache::load(GLuint program_id, uint64_t key)
+{
+    if (!m_supported) return false;
+
+    std::ifstream infile(get_entry_path(key), std::ios::binary);
+    CacheHeader header;
+    if (!infile.read((char*)&header, sizeof(header)) || header.magic != CACHE_MAGIC || header.key != key)
+    {
+        m_misses++;
+        return false;
+    }
+
+    // the header is untrusted, so check the length against what is actually on disk before allocating
+    std::streamoff header_end = infile.tellg();
+    infile.seekg(0, std::ios::end);
+    std::streamoff remaining = infile.tellg() - header_end;
+    infile.seekg(header_end);
+    if (header.length == 0 || header.length > MAX_BINARY_LENGTH || remaining < 0 || (uint64_t)remaining != header.length)
+    {
+        m_misses++;
+        return false;
+    }
+
+    std::vector<char> binary((size_t)header.length);
+    if (!infile.read(binary.data(), binary.size()))
+    {
+        m_misses++;
+        return false;
+    }
+
+    glProgramBinary(program_id, (GLenum)header.format, binary.data(), (GLsizei)binary.size());
+
+    // the driver is free to reject a binary (for example after an update) -- caller recompiles
+    GLint link_success;
+    glGetProgramiv(program_id, GL_LINK_STATUS, &link_success);
+    if (link_success == GL_FALSE)
+    {
+        m_misses++;
+        return false;
+    }
+
+    m_hits++;
+    return true;
+}
+
+void ShaderCache::save(GLuint program_id, uint64_t key)
+{
+    if (!m_supported) return;
+
+    GLint length = 0;
+    glGetProgramiv(program_id, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+
+    std::vector<char> binary((size_t)length);
+    GLenum format;
+    glGetProgramBinary(program_id, length, NULL, &format, binary.data());
+
+    ensure_directory();
+
+    // written to the side and renamed so a concurrently starting instance never reads half a file
+    std::string path = get_entry_path(key);
+#ifdef _WINDOWS
+    int process_id = _getpid();
+#else
+    int process_id = (int)getpid();
+#endif
+    // the process id keeps two instances saving the same entry from writing into one temporary
+    std::string temporary_path = path + "." + std::to_string(process_id) + ".tmp";
+    {
+        CacheHeader header = { CACHE_MAGIC, (uint32_t)format, key, (uint64_t)length };
+        std::ofstream outfile(temporary_path, std::ios::binary | std::ios::trunc);
+        outfile.write((const char*)&header, sizeof(header));
+        outfile.write(binary.data(), binary.size());
+
+        if (!outfile.good())
+        {
+            std::cout << "Unable to write shader cache in " << m_directory << std::endl;
+            return;
+        }
+    }
+
+    std::remove(path.c_str());
+    std::rename(temporary_path.c_str(), path.c_str());
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#ifdef _WINDOWS
+#include <GL/glew.h>
+#endif
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL_opengl.h>
+#include <stdint.h>
+#include <string>
+
+// on-disk cache of linked program binaries so relaunches skip glCompileShader and glLinkProgram
+// entries are keyed by the shader sources plus the driver vendor, renderer and version strings,
+// so a driver update simply misses the cache instead of loading a stale binary
+class ShaderCache
+{
+private:
+    std::string get_entry_path(uint64_t key) const;
+    void ensure_directory() const;
+
+    std::string m_directory;
+    bool m_supported;
+
+    int m_hits;
+    int m_misses;
+
+public:
+    void initialise(const std::string& directory);
+
+    uint64_t compute_key(const std::string& vertex_source, const std::string& fragment_source) const;
+
+    // returns true when the program was linked from a cached binary
+    bool load(GLuint program_id, uint64_t key);
+    void save(GLuint program_id, uint64_t key);
+
+    bool const is_supported() const { return m_supported; };
+    int const get_hits()      const { return m_hits; };
+    int const get_misses()    const { return m_misses; };
+};
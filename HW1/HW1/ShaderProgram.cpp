@@ -1,48 +1,181 @@
 #define GL_SILENCE_DEPRECATION
 
 #include "ShaderProgram.h"
+#include "Profiler.h"
 
-void ShaderProgram::load(const char* vertex_shader_file, const char* fragment_shader_file) {
+GLStateCache ShaderProgram::s_state = { 0, 0, 0, 0, 0 };
 
-    // create the vertex shader
-    m_vertex_shader = load_shader_from_file(vertex_shader_file, GL_VERTEX_SHADER);
-    // create the fragment shader
-    m_fragment_shader = load_shader_from_file(fragment_shader_file, GL_FRAGMENT_SHADER);
+void ShaderProgram::load(const char* vertex_shader_file, const char* fragment_shader_file, ShaderCache* cache) {
+    PROFILE_SCOPE("ShaderProgram::load");
+
+    std::string vertex_source = read_shader_file(vertex_shader_file);
+    std::string fragment_source = read_shader_file(fragment_shader_file);
+    m_vertex_path = vertex_shader_file;
+    m_fragment_path = fragment_shader_file;
+    m_vertex_source = vertex_source;
+    m_fragment_source = fragment_source;
 
-    // Create the final shader program from our vertex and fragment shaders
     m_program_id = glCreateProgram();
-    glAttachShader(m_program_id, m_vertex_shader);
-    glAttachShader(m_program_id, m_fragment_shader);
-    glLinkProgram(m_program_id);
+    m_vertex_shader = 0;
+    m_fragment_shader = 0;
 
-    GLint link_success;
-    glGetProgramiv(m_program_id, GL_LINK_STATUS, &link_success);
+    // try the binary from a previous launch before compiling anything
+    bool use_cache = cache != NULL && cache->is_supported();
+    uint64_t cache_key = use_cache ? cache->compute_key(vertex_source, fragment_source) : 0;
 
-    if (link_success == GL_FALSE)
+    if (!use_cache || !cache->load(m_program_id, cache_key))
     {
-        printf("Error linking shader program!\n");
+        // a rejected binary leaves the program unusable, so start over with a fresh one
+        if (use_cache)
+        {
+            glDeleteProgram(m_program_id);
+            m_program_id = glCreateProgram();
+        }
+
+        // a failed link would otherwise be cached and handed back on every later launch
+        bool linked = link_from_source(vertex_source, fragment_source, use_cache);
+        if (use_cache && linked) cache->save(m_program_id, cache_key);
     }
 
+    query_locations();
+}
+
+void ShaderProgram::query_locations()
+{
     m_model_matrix_uniform = glGetUniformLocation(m_program_id, "modelMatrix");
     m_projection_matrix_uniform = glGetUniformLocation(m_program_id, "projectionMatrix");
     m_view_matrix_uniform = glGetUniformLocation(m_program_id, "viewMatrix");
     m_colour_uniform = glGetUniformLocation(m_program_id, "color");
+    m_bone_real_uniform = glGetUniformLocation(m_program_id, "boneReal");
+    m_bone_dual_uniform = glGetUniformLocation(m_program_id, "boneDual");
+    m_bone_pivot_scale_uniform = glGetUniformLocation(m_program_id, "bonePivotScale");
+
+    // programs built from the *_ubo.glsl shaders read the camera from the shared uniform block
+    GLuint camera_block_index = glGetUniformBlockIndex(m_program_id, "Camera");
+    m_uses_camera_block = camera_block_index != GL_INVALID_INDEX;
+    if (m_uses_camera_block) glUniformBlockBinding(m_program_id, camera_block_index, CAMERA_BLOCK_BINDING);
 
     m_position_attribute = glGetAttribLocation(m_program_id, "position");
     m_tex_coord_attribute = glGetAttribLocation(m_program_id, "texCoord");
+    m_bone_indices_attribute = glGetAttribLocation(m_program_id, "boneIndices");
+    m_bone_weights_attribute = glGetAttribLocation(m_program_id, "boneWeights");
+    m_instance_axes_attribute = glGetAttribLocation(m_program_id, "instanceAxes");
+    m_instance_origin_attribute = glGetAttribLocation(m_program_id, "instanceOrigin");
+    m_instance_uv_rect_attribute = glGetAttribLocation(m_program_id, "instanceUvRect");
 
+    reset_uniform_cache();
     set_colour(1.0f, 1.0f, 1.0f, 1.0f);
+}
+
+// pins every attribute the program has now to the same slot for the next link
+void ShaderProgram::bind_attribute_locations(GLuint program_id)
+{
+    const char* names[] = { "position", "texCoord", "boneIndices", "boneWeights", "instanceAxes", "instanceOrigin", "instanceUvRect" };
+    GLuint locations[] = { m_position_attribute, m_tex_coord_attribute, m_bone_indices_attribute, m_bone_weights_attribute,
+                           m_instance_axes_attribute, m_instance_origin_attribute, m_instance_uv_rect_attribute };
+
+    for (int i = 0; i < 7; i++)
+    {
+        if (locations[i] != (GLuint)-1) glBindAttribLocation(program_id, locations[i], names[i]);
+    }
+}
+
+bool ShaderProgram::reload(const std::string& path, const std::string& source)
+{
+    PROFILE_SCOPE("ShaderProgram::reload");
+    if (!uses_file(path)) return false;
+
+    const std::string& vertex_source = path == m_vertex_path ? source : m_vertex_source;
+    const std::string& fragment_source = path == m_fragment_path ? source : m_fragment_source;
+
+    GLuint vertex_shader = load_shader_from_string(vertex_source, GL_VERTEX_SHADER);
+    GLuint fragment_shader = load_shader_from_string(fragment_source, GL_FRAGMENT_SHADER);
+
+    // a trial link on a scratch program first -- a failed link on the real one would leave it unusable
+    GLuint trial = glCreateProgram();
+    glAttachShader(trial, vertex_shader);
+    glAttachShader(trial, fragment_shader);
+    bind_attribute_locations(trial);
+    glLinkProgram(trial);
+
+    GLint link_success;
+    glGetProgramiv(trial, GL_LINK_STATUS, &link_success);
+    glDeleteProgram(trial);
+
+    if (link_success == GL_FALSE)
+    {
+        printf("Error reloading shader program, keeping the old one!\n");
+        glDeleteShader(vertex_shader);
+        glDeleteShader(fragment_shader);
+        return false;
+    }
+
+    // programs restored from the binary cache never had shaders attached
+    if (m_vertex_shader != 0)
+    {
+        glDetachShader(m_program_id, m_vertex_shader);
+        glDeleteShader(m_vertex_shader);
+    }
+    if (m_fragment_shader != 0)
+    {
+        glDetachShader(m_program_id, m_fragment_shader);
+        glDeleteShader(m_fragment_shader);
+    }
+
+    m_vertex_shader = vertex_shader;
+    m_fragment_shader = fragment_shader;
+    glAttachShader(m_program_id, m_vertex_shader);
+    glAttachShader(m_program_id, m_fragment_shader);
+    bind_attribute_locations(m_program_id);
+    glLinkProgram(m_program_id);
+
+    m_vertex_source = vertex_source;
+    m_fragment_source = fragment_source;
+    query_locations();
+    return true;
+}
+
+bool ShaderProgram::link_from_source(const std::string& vertex_source, const std::string& fragment_source, bool retrievable)
+{
+    // create the vertex shader
+    m_vertex_shader = load_shader_from_string(vertex_source, GL_VERTEX_SHADER);
+    // create the fragment shader
+    m_fragment_shader = load_shader_from_string(fragment_source, GL_FRAGMENT_SHADER);
+
+    // Create the final shader program from our vertex and fragment shaders
+    if (retrievable) glProgramParameteri(m_program_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glAttachShader(m_program_id, m_vertex_shader);
+    glAttachShader(m_program_id, m_fragment_shader);
+    glLinkProgram(m_program_id);
+
+    GLint link_success;
+    glGetProgramiv(m_program_id, GL_LINK_STATUS, &link_success);
+
+    if (link_success == GL_FALSE)
+    {
+        printf("Error linking shader program!\n");
+        return false;
+    }
+    return true;
+}
 
+void ShaderProgram::reset_uniform_cache()
+{
+    m_has_model_matrix = false;
+    m_has_view_matrix = false;
+    m_has_projection_matrix = false;
+    m_has_colour = false;
 }
 
 void ShaderProgram::cleanup()
 {
+    if (s_state.bound_program == m_program_id) s_state.bound_program = 0;
     glDeleteProgram(m_program_id);
     glDeleteShader(m_vertex_shader);
     glDeleteShader(m_fragment_shader);
 }
 
-GLuint ShaderProgram::load_shader_from_file(const std::string& shaderFile, GLenum type)
+std::string ShaderProgram::read_shader_file(const std::string& shaderFile)
 {
     //Open a file stream with the file name
     std::ifstream infile(shaderFile);
@@ -54,9 +187,13 @@ GLuint ShaderProgram::load_shader_from_file(const std::string& shaderFile, GLenu
     //Create a string buffer and stream the file to it
     std::stringstream buffer;
     buffer << infile.rdbuf();
+    return buffer.str();
+}
 
+GLuint ShaderProgram::load_shader_from_file(const std::string& shaderFile, GLenum type)
+{
     // Load the shader from the contents of the file
-    return load_shader_from_string(buffer.str(), type);
+    return load_shader_from_string(read_shader_file(shaderFile), type);
 }
 
 GLuint ShaderProgram::load_shader_from_string(const std::string& shaderContents, GLenum type)
@@ -88,26 +225,85 @@ GLuint ShaderProgram::load_shader_from_string(const std::string& shaderContents,
     return shaderID;
 }
 
-void ShaderProgram::set_colour(float red, float green, float blue, float alpha)
+// only calls glUseProgram when a different program is bound
+void ShaderProgram::bind()
 {
+    if (s_state.bound_program == m_program_id)
+    {
+        s_state.binds_skipped++;
+        return;
+    }
+
     glUseProgram(m_program_id);
+    s_state.bound_program = m_program_id;
+    s_state.binds_performed++;
+}
+
+// compares against the last uploaded value and remembers the new one
+bool ShaderProgram::upload_needed(bool& has_value, glm::mat4& cached, const glm::mat4& matrix)
+{
+    if (has_value && cached == matrix)
+    {
+        s_state.uploads_skipped++;
+        return false;
+    }
+
+    has_value = true;
+    cached = matrix;
+    s_state.uploads_performed++;
+    return true;
+}
+
+void ShaderProgram::set_colour(float red, float green, float blue, float alpha)
+{
+    glm::vec4 colour = glm::vec4(red, green, blue, alpha);
+    if (m_has_colour && m_colour_value == colour)
+    {
+        s_state.uploads_skipped++;
+        return;
+    }
+
+    m_has_colour = true;
+    m_colour_value = colour;
+    s_state.uploads_performed++;
+
+    bind();
     glUniform4f(m_colour_uniform, red, green, blue, alpha);
 }
 
 void ShaderProgram::set_view_matrix(const glm::mat4& matrix)
 {
-    glUseProgram(m_program_id);
+    // the view matrix lives in the CameraBlock for these programs
+    if (m_uses_camera_block) return;
+    if (!upload_needed(m_has_view_matrix, m_view_matrix_value, matrix)) return;
+
+    bind();
     glUniformMatrix4fv(m_view_matrix_uniform, 1, GL_FALSE, &matrix[0][0]);
 }
 
 void ShaderProgram::set_model_matrix(const glm::mat4& matrix)
 {
-    glUseProgram(m_program_id);
+    if (!upload_needed(m_has_model_matrix, m_model_matrix_value, matrix)) return;
+
+    bind();
     glUniformMatrix4fv(m_model_matrix_uniform, 1, GL_FALSE, &matrix[0][0]);
 }
 
 void ShaderProgram::set_projection_matrix(const glm::mat4& matrix)
 {
-    glUseProgram(m_program_id);
+    if (m_uses_camera_block) return;
+    if (!upload_needed(m_has_projection_matrix, m_projection_matrix_value, matrix)) return;
+
+    bind();
     glUniformMatrix4fv(m_projection_matrix_uniform, 1, GL_FALSE, &matrix[0][0]);
+}
+
+void ShaderProgram::set_bone_palette(const glm::vec4* real, const glm::vec4* dual, const glm::vec4* pivot_scale, int bone_count)
+{
+    s_state.uploads_performed++;
+
+    bind();
+    glUniform4fv(m_bone_real_uniform, bone_count, &real[0][0]);
+    glUniform4fv(m_bone_dual_uniform, bone_count, &dual[0][0]);
+    glUniform4fv(m_bone_pivot_scale_uniform, bone_count, &pivot_scale[0][0]);
 }
\ No newline at end of file
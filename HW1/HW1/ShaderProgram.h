@@ -10,40 +10,118 @@
 #include <fstream>
 #include <sstream>
 #include "glm/mat4x4.hpp"
+#include "glm/vec4.hpp"
+#include "CameraBlock.h"
+#include "ShaderCache.h"
+
+// GL state shared by every ShaderProgram -- lets redundant binds and uploads be skipped
+struct GLStateCache
+{
+    GLuint bound_program;
+
+    unsigned long binds_performed;
+    unsigned long binds_skipped;
+    unsigned long uploads_performed;
+    unsigned long uploads_skipped;
+};
 
 class ShaderProgram
 {
 private:
     void cleanup();
+    void reset_uniform_cache();
+    bool upload_needed(bool& has_value, glm::mat4& cached, const glm::mat4& matrix);
 
     GLuint load_shader_from_string(const std::string& shader_contents, GLenum shader_type);
     GLuint load_shader_from_file(const std::string& shader_file, GLenum shader_type);
+    std::string read_shader_file(const std::string& shader_file);
+    bool link_from_source(const std::string& vertex_source, const std::string& fragment_source, bool retrievable);
+    void query_locations();
+    void bind_attribute_locations(GLuint program_id);
 
     GLuint m_program_id;
 
+    // kept so a single changed file can be swapped in and the program relinked
+    std::string m_vertex_path;
+    std::string m_fragment_path;
+    std::string m_vertex_source;
+    std::string m_fragment_source;
+
     GLuint m_projection_matrix_uniform;
     GLuint m_model_matrix_uniform;
     GLuint m_view_matrix_uniform;
     GLuint m_colour_uniform;
 
+    // only found in the skinned shader
+    GLuint m_bone_real_uniform;
+    GLuint m_bone_dual_uniform;
+    GLuint m_bone_pivot_scale_uniform;
+
+    bool m_uses_camera_block;
+
     GLuint m_position_attribute;
     GLuint m_tex_coord_attribute;
+    GLuint m_bone_indices_attribute;
+    GLuint m_bone_weights_attribute;
+
+    // only found in the instanced shader
+    GLuint m_instance_axes_attribute;
+    GLuint m_instance_origin_attribute;
+    GLuint m_instance_uv_rect_attribute;
 
     GLuint m_vertex_shader;
     GLuint m_fragment_shader;
 
+    // last value uploaded to each uniform -- re-uploading the same value is a no-op
+    glm::mat4 m_model_matrix_value;
+    glm::mat4 m_view_matrix_value;
+    glm::mat4 m_projection_matrix_value;
+    glm::vec4 m_colour_value;
+
+    bool m_has_model_matrix;
+    bool m_has_view_matrix;
+    bool m_has_projection_matrix;
+    bool m_has_colour;
+
+    static GLStateCache s_state;
+
 public:
 
-    void load(const char* vertex_shader_file, const char* fragment_shader_file);
+    // pass a ShaderCache to reuse the linked binary from a previous launch
+    void load(const char* vertex_shader_file, const char* fragment_shader_file, ShaderCache* cache = NULL);
+
+    // relinks the same program with new source for whichever stage came from path -- the program id and every
+    // attribute location stay put, so VAOs built against it keep working
+    // anything that fails to compile or link leaves the running program as it was
+    // uniforms start over after a relink, so the caller sets its matrices again
+    bool reload(const std::string& path, const std::string& source);
+    bool uses_file(const std::string& path) const { return path == m_vertex_path || path == m_fragment_path; };
 
     void set_model_matrix(const glm::mat4& matrix);
     void set_projection_matrix(const glm::mat4& matrix);
     void set_view_matrix(const glm::mat4& matrix);
     void set_colour(float red, float green, float blue, float alpha);
 
+    // dual quaternions as (x, y, z, w) plus the pivot and scale for each bone -- changes every draw, so never cached
+    void set_bone_palette(const glm::vec4* real, const glm::vec4* dual, const glm::vec4* pivot_scale, int bone_count);
+
+    void bind();
+
+    // call after binding a program with glUseProgram directly so the cache does not go stale
+    static void invalidate_bound_program() { s_state.bound_program = 0; };
+    static const GLStateCache& get_state_cache() { return s_state; };
+
     GLuint const get_program_id()               const { return m_program_id; };
     GLuint const get_position_attribute()       const { return m_position_attribute; };
     GLuint const get_tex_coordinate_attribute() const { return m_tex_coord_attribute; };
+    GLuint const get_bone_indices_attribute()   const { return m_bone_indices_attribute; };
+    GLuint const get_bone_weights_attribute()   const { return m_bone_weights_attribute; };
+    GLuint const get_instance_axes_attribute()  const { return m_instance_axes_attribute; };
+    GLuint const get_instance_origin_attribute()  const { return m_instance_origin_attribute; };
+    GLuint const get_instance_uv_rect_attribute() const { return m_instance_uv_rect_attribute; };
+    bool const uses_camera_block()              const { return m_uses_camera_block; };
+    const std::string& get_vertex_path()        const { return m_vertex_path; };
+    const std::string& get_fragment_path()      const { return m_fragment_path; };
 
     void set_program_id(GLuint program_id) { m_program_id = program_id; };
 };
\ No newline at end of file
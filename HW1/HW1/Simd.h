@@ -0,0 +1,19 @@
+#pragma once
+
+// raw SSE2 for the few hot loops that are written four lanes at a time -- glm's own SIMD switches
+// (GLM_FORCE_INTRINSICS and friends) are left alone, they change what glm compiles to and would
+// have to be set the same way for every file in the project
+// SSE2 is always there on x64 and needs /arch:SSE2 or -msse2 on 32-bit x86, everything else takes
+// the scalar paths
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HAS_SSE2 1
+#include <emmintrin.h>
+
+// clears the sign bits
+inline __m128 abs_ps(__m128 value)
+{
+    return _mm_and_ps(value, _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff)));
+}
+#else
+#define HAS_SSE2 0
+#endif
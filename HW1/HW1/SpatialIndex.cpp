@@ -0,0 +1,338 @@
+#include "SpatialIndex.h"
+#include "glm/common.hpp"
+#include "glm/gtc/bitfield.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+const int LooseQuadtree::NO_ITEM;
+const int LooseQuadtree::OUTSIDE;
+const int LooseQuadtree::MAX_DEPTH;
+const int HashGrid::NO_ITEM;
+
+namespace
+{
+    bool contains(const CullBounds& bounds, const glm::vec2& point)
+    {
+        glm::vec2 distance = glm::abs(point - bounds.centre);
+        return distance.x <= bounds.half_size.x && distance.y <= bounds.half_size.y;
+    }
+
+    // grows the per-id arrays so id is a valid index
+    template <typename T>
+    void fit(std::vector<T>& values, int id, const T& fill)
+    {
+        if ((size_t)id >= values.size()) values.resize(id + 1, fill);
+    }
+}
+
+void LooseQuadtree::initialise(const CullBounds& world, int max_depth)
+{
+    assert(max_depth >= 0 && max_depth <= MAX_DEPTH);
+    max_depth = std::min(std::max(max_depth, 0), MAX_DEPTH);
+    m_world = world;
+    m_max_depth = max_depth;
+
+    m_level_offsets.resize(max_depth + 2);
+    int total = 0;
+    for (int depth = 0; depth <= max_depth; depth++)
+    {
+        m_level_offsets[depth] = total;
+        total += 1 << (2 * depth);
+    }
+    m_level_offsets[max_depth + 1] = total;
+
+    m_node_heads.assign(total, NO_ITEM);
+    m_subtree_counts.assign(total, 0);
+    clear();
+}
+
+void LooseQuadtree::clear()
+{
+    std::fill(m_node_heads.begin(), m_node_heads.end(), NO_ITEM);
+    std::fill(m_subtree_counts.begin(), m_subtree_counts.end(), 0);
+    m_bounds.clear();
+    m_nodes.clear();
+    m_next.clear();
+    m_previous.clear();
+    m_outside.clear();
+}
+
+// the deepest level whose cells are at least as big as the item, then the cell holding its centre
+int LooseQuadtree::find_node(const CullBounds& bounds) const
+{
+    // the root's loose bounds are twice the world -- anything reaching past them has no node
+    glm::vec2 reach = glm::abs(bounds.centre - m_world.centre) + bounds.half_size;
+    if (reach.x > m_world.half_size.x * 2.0f || reach.y > m_world.half_size.y * 2.0f) return OUTSIDE;
+
+    // centred off the world, only the root's loose bounds are sure to hold it
+    if (!contains(m_world, bounds.centre)) return m_level_offsets[0];
+
+    int depth = 0;
+    glm::vec2 cell_half = m_world.half_size;
+    while (depth < m_max_depth && bounds.half_size.x <= cell_half.x * 0.5f && bounds.half_size.y <= cell_half.y * 0.5f)
+    {
+        cell_half *= 0.5f;
+        depth++;
+    }
+
+    const int cells = 1 << depth;
+    glm::vec2 cell = glm::floor((bounds.centre - (m_world.centre - m_world.half_size)) / (cell_half * 2.0f));
+    int x = glm::clamp((int)cell.x, 0, cells - 1);
+    int y = glm::clamp((int)cell.y, 0, cells - 1);
+    return m_level_offsets[depth] + (int)glm::bitfieldInterleave((glm::uint16)x, (glm::uint16)y);
+}
+
+void LooseQuadtree::link(int id, int node)
+{
+    m_nodes[id] = node;
+    m_previous[id] = NO_ITEM;
+
+    if (node == OUTSIDE)
+    {
+        m_next[id] = NO_ITEM;
+        m_outside.push_back(id);
+        return;
+    }
+
+    m_next[id] = m_node_heads[node];
+    if (m_next[id] != NO_ITEM) m_previous[m_next[id]] = id;
+    m_node_heads[node] = id;
+    adjust_counts(node, 1);
+}
+
+void LooseQuadtree::unlink(int id)
+{
+    const int node = m_nodes[id];
+    m_nodes[id] = NO_ITEM;
+
+    if (node == OUTSIDE)
+    {
+        m_outside.erase(std::find(m_outside.begin(), m_outside.end(), id));
+        return;
+    }
+
+    if (m_previous[id] != NO_ITEM) m_next[m_previous[id]] = m_next[id];
+    else m_node_heads[node] = m_next[id];
+    if (m_next[id] != NO_ITEM) m_previous[m_next[id]] = m_previous[id];
+    adjust_counts(node, -1);
+}
+
+// walks from the node up to the root -- a parent's Morton code is the child's shifted down two bits
+void LooseQuadtree::adjust_counts(int node, int delta)
+{
+    int depth = 0;
+    while (node >= m_level_offsets[depth + 1]) depth++;
+
+    glm::uint32 morton = (glm::uint32)(node - m_level_offsets[depth]);
+    for (; depth >= 0; depth--, morton >>= 2) m_subtree_counts[m_level_offsets[depth] + morton] += delta;
+}
+
+void LooseQuadtree::insert(int id, const CullBounds& bounds)
+{
+    fit(m_bounds, id, bounds);
+    fit(m_nodes, id, (int)NO_ITEM);
+    fit(m_next, id, (int)NO_ITEM);
+    fit(m_previous, id, (int)NO_ITEM);
+    assert(m_nodes[id] == NO_ITEM);
+
+    m_bounds[id] = bounds;
+    link(id, find_node(bounds));
+}
+
+void LooseQuadtree::move(int id, const CullBounds& bounds)
+{
+    m_bounds[id] = bounds;
+
+    // most moves stay inside the same node and only need the new box
+    int node = find_node(bounds);
+    if (node == m_nodes[id]) return;
+
+    unlink(id);
+    link(id, node);
+}
+
+void LooseQuadtree::remove(int id)
+{
+    if ((size_t)id < m_nodes.size() && m_nodes[id] != NO_ITEM) unlink(id);
+}
+
+void LooseQuadtree::query_node(int depth, glm::uint32 morton, const CullBounds& range, std::vector<int>& out) const
+{
+    const int node = m_level_offsets[depth] + (int)morton;
+    if (m_subtree_counts[node] == 0) return;
+
+    // the cell's centre from its coordinates, and twice the cell as the loose bounds
+    glm::u16vec2 cell = glm::bitfieldDeinterleave(morton);
+    glm::vec2 cell_size = m_world.half_size * 2.0f / (float)(1 << depth);
+    CullBounds loose;
+    loose.centre = m_world.centre - m_world.half_size + (glm::vec2(cell) + 0.5f) * cell_size;
+    loose.half_size = cell_size;
+    if (!is_visible(loose, range)) return;
+
+    for (int id = m_node_heads[node]; id != NO_ITEM; id = m_next[id])
+    {
+        if (is_visible(m_bounds[id], range)) out.push_back(id);
+    }
+
+    if (depth == m_max_depth) return;
+    for (glm::uint32 child = 0; child < 4; child++) query_node(depth + 1, (morton << 2) | child, range, out);
+}
+
+void LooseQuadtree::query(const CullBounds& range, std::vector<int>& out) const
+{
+    if (!m_subtree_counts.empty()) query_node(0, 0, range, out);
+    for (int id : m_outside)
+    {
+        if (is_visible(m_bounds[id], range)) out.push_back(id);
+    }
+}
+
+int LooseQuadtree::pick(const glm::vec2& point) const
+{
+    CullBounds range;
+    range.centre = point;
+    range.half_size = glm::vec2(0.0f);
+
+    std::vector<int> hits;
+    query(range, hits);
+
+    int top = NO_ITEM;
+    for (int id : hits)
+    {
+        if (id > top && contains(m_bounds[id], point)) top = id;
+    }
+    return top;
+}
+
+glm::uint32 HashGrid::cell_key(int x, int y)
+{
+    // the bias keeps small negative coordinates apart from small positive ones before the wrap
+    return glm::bitfieldInterleave((glm::uint16)(x + 32768), (glm::uint16)(y + 32768));
+}
+
+void HashGrid::initialise(float cell_size)
+{
+    m_cell_size = cell_size;
+    clear();
+}
+
+void HashGrid::clear()
+{
+    m_cells.clear();
+    m_bounds.clear();
+    m_ranges.clear();
+    m_present.clear();
+    m_query_marks.clear();
+    m_query_stamp = 0;
+}
+
+HashGrid::CellRange HashGrid::find_cells(const CullBounds& bounds) const
+{
+    glm::vec2 low = glm::floor((bounds.centre - bounds.half_size) / m_cell_size);
+    glm::vec2 high = glm::floor((bounds.centre + bounds.half_size) / m_cell_size);
+    CellRange cells = { (int)low.x, (int)low.y, (int)high.x, (int)high.y };
+    return cells;
+}
+
+void HashGrid::add_to_cells(int id, const CellRange& cells)
+{
+    for (int y = cells.min_y; y <= cells.max_y; y++)
+    {
+        for (int x = cells.min_x; x <= cells.max_x; x++) m_cells[cell_key(x, y)].push_back(id);
+    }
+}
+
+void HashGrid::remove_from_cells(int id, const CellRange& cells)
+{
+    for (int y = cells.min_y; y <= cells.max_y; y++)
+    {
+        for (int x = cells.min_x; x <= cells.max_x; x++)
+        {
+            std::unordered_map<glm::uint32, std::vector<int> >::iterator cell = m_cells.find(cell_key(x, y));
+            std::vector<int>& ids = cell->second;
+
+            // order inside a cell does not matter, so swap the last entry into the hole
+            std::vector<int>::iterator entry = std::find(ids.begin(), ids.end(), id);
+            *entry = ids.back();
+            ids.pop_back();
+            if (ids.empty()) m_cells.erase(cell);
+        }
+    }
+}
+
+void HashGrid::insert(int id, const CullBounds& bounds)
+{
+    fit(m_bounds, id, bounds);
+    fit(m_ranges, id, CellRange());
+    fit(m_present, id, (unsigned char)0);
+    fit(m_query_marks, id, 0u);
+    assert(!m_present[id]);
+
+    m_bounds[id] = bounds;
+    m_ranges[id] = find_cells(bounds);
+    m_present[id] = 1;
+    add_to_cells(id, m_ranges[id]);
+}
+
+void HashGrid::move(int id, const CullBounds& bounds)
+{
+    m_bounds[id] = bounds;
+
+    CellRange cells = find_cells(bounds);
+    const CellRange& old = m_ranges[id];
+    if (cells.min_x == old.min_x && cells.min_y == old.min_y && cells.max_x == old.max_x && cells.max_y == old.max_y) return;
+
+    remove_from_cells(id, old);
+    m_ranges[id] = cells;
+    add_to_cells(id, cells);
+}
+
+void HashGrid::remove(int id)
+{
+    if ((size_t)id >= m_present.size() || !m_present[id]) return;
+
+    remove_from_cells(id, m_ranges[id]);
+    m_present[id] = 0;
+}
+
+void HashGrid::query(const CullBounds& range, std::vector<int>& out) const
+{
+    // a fresh stamp instead of clearing every mark, wiping them only when the counter wraps
+    if (++m_query_stamp == 0)
+    {
+        std::fill(m_query_marks.begin(), m_query_marks.end(), 0u);
+        m_query_stamp = 1;
+    }
+
+    CellRange cells = find_cells(range);
+    for (int y = cells.min_y; y <= cells.max_y; y++)
+    {
+        for (int x = cells.min_x; x <= cells.max_x; x++)
+        {
+            std::unordered_map<glm::uint32, std::vector<int> >::const_iterator cell = m_cells.find(cell_key(x, y));
+            if (cell == m_cells.end()) continue;
+
+            for (int id : cell->second)
+            {
+                if (m_query_marks[id] == m_query_stamp) continue;
+                m_query_marks[id] = m_query_stamp;
+                if (is_visible(m_bounds[id], range)) out.push_back(id);
+            }
+        }
+    }
+}
+
+int HashGrid::pick(const glm::vec2& point) const
+{
+    glm::vec2 cell = glm::floor(point / m_cell_size);
+    std::unordered_map<glm::uint32, std::vector<int> >::const_iterator found = m_cells.find(cell_key((int)cell.x, (int)cell.y));
+    if (found == m_cells.end()) return NO_ITEM;
+
+    int top = NO_ITEM;
+    for (int id : found->second)
+    {
+        if (id > top && contains(m_bounds[id], point)) top = id;
+    }
+    return top;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+#include "glm/vec2.hpp"
+#include "glm/gtc/type_precision.hpp"
+#include "Culling.h"
+
+// both indexes store caller-chosen ids (entity indices) with a box each and support the same calls,
+// so either one can sit behind culling, picking or a collision broad phase
+// ids should be dense -- per-id state is kept in arrays indexed by id
+
+// loose quadtree over a fixed world rectangle
+// every level is a dense grid addressed by the Morton code of the cell, so a node's children are 4m .. 4m + 3
+// nodes are twice the size of their cell, which lets every item sit in exactly one node picked from its
+// size and centre -- moving an item is a relink at most, never a split or a merge
+class LooseQuadtree
+{
+private:
+    CullBounds m_world;
+    int m_max_depth;
+
+    std::vector<int> m_level_offsets;       // first node of each level
+    std::vector<int> m_node_heads;          // first item in each node, or NO_ITEM
+    std::vector<int> m_subtree_counts;      // items in a node and everything below it, lets queries skip empty branches
+
+    std::vector<CullBounds> m_bounds;
+    std::vector<int> m_nodes;               // per id, NO_ITEM when the id is not in the tree
+    std::vector<int> m_next;                // intrusive doubly linked lists per node
+    std::vector<int> m_previous;
+
+    std::vector<int> m_outside;             // items too far out of the world for any node to hold
+
+    int find_node(const CullBounds& bounds) const;
+    void link(int id, int node);
+    void unlink(int id);
+    void adjust_counts(int node, int delta);
+    void query_node(int depth, glm::uint32 morton, const CullBounds& range, std::vector<int>& out) const;
+
+public:
+    static const int NO_ITEM = -1;
+    static const int OUTSIDE = -2;
+
+    // every level is allocated up front -- 12 levels is about 22 million nodes, already 180 MB of heads and counts,
+    // and keeps node indices well inside an int and cell coordinates inside the 16 bit interleave
+    static const int MAX_DEPTH = 12;
+
+    void initialise(const CullBounds& world, int max_depth);
+    void clear();
+
+    void insert(int id, const CullBounds& bounds);
+    void move(int id, const CullBounds& bounds);
+    void remove(int id);
+
+    // appends every id whose box overlaps the range
+    void query(const CullBounds& range, std::vector<int>& out) const;
+
+    // the highest id whose box holds the point -- the one drawn on top -- or NO_ITEM
+    int pick(const glm::vec2& point) const;
+};
+
+// uniform grid of square cells over an unbounded plane, stored sparsely in a hash map
+// cells are keyed by the Morton code of their coordinates so neighbouring cells get neighbouring keys;
+// coordinates wrap every 65536 cells, which only means distant cells can share a bucket
+// an item is listed in every cell its box touches
+class HashGrid
+{
+private:
+    struct CellRange
+    {
+        int min_x, min_y, max_x, max_y;
+    };
+
+    float m_cell_size;
+    std::unordered_map<glm::uint32, std::vector<int> > m_cells;
+
+    std::vector<CullBounds> m_bounds;
+    std::vector<CellRange> m_ranges;
+    std::vector<unsigned char> m_present;
+
+    // stamps ids already reported so an item spanning several cells is only appended once
+    mutable std::vector<unsigned int> m_query_marks;
+    mutable unsigned int m_query_stamp;
+
+    CellRange find_cells(const CullBounds& bounds) const;
+    void add_to_cells(int id, const CellRange& cells);
+    void remove_from_cells(int id, const CellRange& cells);
+
+public:
+    static const int NO_ITEM = -1;
+
+    static glm::uint32 cell_key(int x, int y);
+
+    // pick a cell size around the size of a typical item -- items spanning many cells cost one entry per cell
+    void initialise(float cell_size);
+    void clear();
+
+    void insert(int id, const CullBounds& bounds);
+    void move(int id, const CullBounds& bounds);
+    void remove(int id);
+
+    void query(const CullBounds& range, std::vector<int>& out) const;
+    int pick(const glm::vec2& point) const;
+
+    size_t const get_cell_count() const { return m_cells.size(); };
+};
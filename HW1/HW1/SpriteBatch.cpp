@@ -0,0 +1,145 @@
+#define GL_SILENCE_DEPRECATION
+
+#include "SpriteBatch.h"
+#include "Profiler.h"
+
+void SpriteBatch::initialise(const ShaderProgram& program, float half_extent, size_t initial_sprites)
+{
+    m_half_extent = half_extent;
+    m_draw_calls = 0;
+    m_vbo_capacity = 0;
+
+    m_sprites.reserve(initial_sprites);
+    m_vertices.reserve(initial_sprites * VERTICES_PER_SPRITE);
+
+    glGenVertexArrays(1, &m_vao);
+    glBindVertexArray(m_vao);
+
+    glGenBuffers(1, &m_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    reserve_vertices(initial_sprites * VERTICES_PER_SPRITE);
+
+    glVertexAttribPointer(program.get_position_attribute(), 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+    glEnableVertexAttribArray(program.get_position_attribute());
+
+    glVertexAttribPointer(program.get_tex_coordinate_attribute(), 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(2 * sizeof(float)));
+    glEnableVertexAttribArray(program.get_tex_coordinate_attribute());
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void SpriteBatch::cleanup()
+{
+    glDeleteBuffers(1, &m_vbo);
+    glDeleteVertexArrays(1, &m_vao);
+}
+
+// grows the GPU buffer -- only happens when a frame has more sprites than ever before
+void SpriteBatch::reserve_vertices(size_t vertex_count)
+{
+    if (vertex_count <= m_vbo_capacity && m_vbo_capacity > 0) return;
+
+    size_t doubled = m_vbo_capacity * 2;
+    m_vbo_capacity = vertex_count > doubled ? vertex_count : doubled;
+    if (m_vbo_capacity == 0) m_vbo_capacity = VERTICES_PER_SPRITE;
+    glBufferData(GL_ARRAY_BUFFER, m_vbo_capacity * sizeof(Vertex), NULL, GL_DYNAMIC_DRAW);
+}
+
+void SpriteBatch::begin()
+{
+    m_sprites.clear();
+    m_draw_calls = 0;
+}
+
+// transforms the four quad corners by the model matrix
+void SpriteBatch::submit(const glm::mat4& model_matrix, GLuint texture_id, const glm::vec4& uv_rect)
+{
+    const glm::mat4& m = model_matrix;
+    const float e = m_half_extent;
+
+    // sprites are flat, so only the x and y columns plus the translation matter
+    glm::vec2 x_axis = glm::vec2(m[0]) * e;
+    glm::vec2 y_axis = glm::vec2(m[1]) * e;
+    glm::vec2 origin = glm::vec2(m[3]);
+
+    Sprite sprite;
+    sprite.corners[0] = origin - x_axis - y_axis;
+    sprite.corners[1] = origin + x_axis - y_axis;
+    sprite.corners[2] = origin + x_axis + y_axis;
+    sprite.corners[3] = origin - x_axis + y_axis;
+    sprite.texture_id = texture_id;
+    sprite.uv_rect = uv_rect;
+    m_sprites.push_back(sprite);
+}
+
+void SpriteBatch::submit_quad(const glm::vec2* corners, GLuint texture_id, const glm::vec4& uv_rect)
+{
+    Sprite sprite;
+    for (int corner = 0; corner < 4; corner++) sprite.corners[corner] = corners[corner];
+    sprite.texture_id = texture_id;
+    sprite.uv_rect = uv_rect;
+    m_sprites.push_back(sprite);
+}
+
+// writes the quad as two triangles
+void SpriteBatch::write_sprite(const Sprite& sprite, Vertex* out) const
+{
+    const glm::vec2& bottom_left  = sprite.corners[0];
+    const glm::vec2& bottom_right = sprite.corners[1];
+    const glm::vec2& top_right    = sprite.corners[2];
+    const glm::vec2& top_left     = sprite.corners[3];
+
+    // texture v runs top to bottom, so the bottom corners take v1
+    const float u0 = sprite.uv_rect.x, v0 = sprite.uv_rect.y,
+                u1 = sprite.uv_rect.z, v1 = sprite.uv_rect.w;
+
+    out[0] = { bottom_left.x,  bottom_left.y,  u0, v1 };  // triangle 1
+    out[1] = { bottom_right.x, bottom_right.y, u1, v1 };
+    out[2] = { top_right.x,    top_right.y,    u1, v0 };
+    out[3] = { bottom_left.x,  bottom_left.y,  u0, v1 };  // triangle 2
+    out[4] = { top_right.x,    top_right.y,    u1, v0 };
+    out[5] = { top_left.x,     top_left.y,     u0, v0 };
+}
+
+// uploads every submitted sprite in one go and draws each run of sprites that share a texture
+// submission order is kept so alpha blending still layers correctly -- pack sprites into
+// an atlas (or submit them grouped by texture) to get one draw per texture page
+void SpriteBatch::flush(ShaderProgram& program)
+{
+    PROFILE_SCOPE("SpriteBatch::flush");
+    if (m_sprites.empty()) return;
+
+    // set_model_matrix() skips a cached identity without binding, so never rely on it to bind for us
+    program.bind();
+
+    m_vertices.resize(m_sprites.size() * VERTICES_PER_SPRITE);
+    for (size_t i = 0; i < m_sprites.size(); i++)
+    {
+        write_sprite(m_sprites[i], &m_vertices[i * VERTICES_PER_SPRITE]);
+    }
+
+    glBindVertexArray(m_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    reserve_vertices(m_vertices.size());
+    glBufferSubData(GL_ARRAY_BUFFER, 0, m_vertices.size() * sizeof(Vertex), m_vertices.data());
+
+    // vertices are already in world space
+    program.set_model_matrix(glm::mat4(1.0f));
+
+    size_t run_start = 0;
+    while (run_start < m_sprites.size())
+    {
+        GLuint texture_id = m_sprites[run_start].texture_id;
+        size_t run_end = run_start + 1;
+        while (run_end < m_sprites.size() && m_sprites[run_end].texture_id == texture_id) run_end++;
+
+        glBindTexture(GL_TEXTURE_2D, texture_id);
+        glDrawArrays(GL_TRIANGLES, (GLint)(run_start * VERTICES_PER_SPRITE), (GLsizei)((run_end - run_start) * VERTICES_PER_SPRITE));
+        m_draw_calls++;
+
+        run_start = run_end;
+    }
+
+    m_sprites.clear();
+}
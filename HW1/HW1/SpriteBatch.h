@@ -0,0 +1,64 @@
+#pragma once
+
+#ifdef _WINDOWS
+#include <GL/glew.h>
+#endif
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL_opengl.h>
+#include <vector>
+#include "glm/mat4x4.hpp"
+#include "glm/vec2.hpp"
+#include "glm/vec4.hpp"
+#include "ShaderProgram.h"
+
+// whole texture -- (u0, v0, u1, v1)
+const glm::vec4 FULL_UV_RECT = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+
+// collects sprites during a frame and draws them with as few draw calls as possible
+// quad corners are transformed on the CPU so every sprite in a run shares one buffer
+class SpriteBatch
+{
+private:
+    // corners in world space -- bottom left, bottom right, top right, top left
+    struct Sprite
+    {
+        glm::vec2 corners[4];
+        GLuint texture_id;
+        glm::vec4 uv_rect;
+    };
+
+    struct Vertex
+    {
+        float x, y;
+        float u, v;
+    };
+
+    void reserve_vertices(size_t vertex_count);
+    void write_sprite(const Sprite& sprite, Vertex* out) const;
+
+    std::vector<Sprite> m_sprites;
+    std::vector<Vertex> m_vertices;
+
+    GLuint m_vao;
+    GLuint m_vbo;
+    size_t m_vbo_capacity; // in vertices
+
+    float m_half_extent;
+    int m_draw_calls;
+
+public:
+    static const int VERTICES_PER_SPRITE = 6;
+
+    void initialise(const ShaderProgram& program, float half_extent, size_t initial_sprites);
+    void cleanup();
+
+    void begin();
+    void submit(const glm::mat4& model_matrix, GLuint texture_id, const glm::vec4& uv_rect = FULL_UV_RECT);
+
+    // a quad whose corners are already in world space, e.g. from CPU skinning -- same corner order as Sprite
+    void submit_quad(const glm::vec2* corners, GLuint texture_id, const glm::vec4& uv_rect = FULL_UV_RECT);
+    void flush(ShaderProgram& program);
+
+    int const get_draw_calls()   const { return m_draw_calls; };
+    size_t const get_sprite_count() const { return m_sprites.size(); };
+};
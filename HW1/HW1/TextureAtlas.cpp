@@ -0,0 +1,310 @@
+#define GL_SILENCE_DEPRECATION
+
+#include "TextureAtlas.h"
+#include <algorithm>
+#include <iostream>
+#include "Profiler.h"
+
+const int TextureAtlas::DEFAULT_PAGE_SIZE;
+const int TextureAtlas::DEFAULT_PADDING;
+const int TextureAtlas::MIPMAPPED_PADDING;
+
+// returns the lowest y at which a rect of the given width can sit when its left edge
+// is on the given segment, or -1 if it runs off the right side of the page
+int TextureAtlas::skyline_height(const Page& page, size_t segment, int width) const
+{
+    int x = page.skyline[segment].x;
+    if (x + width > m_page_size) return -1;
+
+    int y = 0;
+    int remaining = width;
+    for (size_t i = segment; remaining > 0 && i < page.skyline.size(); i++)
+    {
+        y = std::max(y, page.skyline[i].y);
+        remaining -= page.skyline[i].width;
+    }
+    return y;
+}
+
+// bottom-left heuristic -- lowest resting spot first, then the narrowest segment to reduce waste
+bool TextureAtlas::find_position(const Page& page, int width, int height, int& out_x, int& out_y, size_t& out_segment) const
+{
+    int best_top = 0, best_width = 0;
+    bool found = false;
+
+    for (size_t i = 0; i < page.skyline.size(); i++)
+    {
+        int y = skyline_height(page, i, width);
+        if (y < 0 || y + height > m_page_size) continue;
+
+        int top = y + height;
+        if (!found || top < best_top || (top == best_top && page.skyline[i].width < best_width))
+        {
+            best_top = top;
+            best_width = page.skyline[i].width;
+            out_x = page.skyline[i].x;
+            out_y = y;
+            out_segment = i;
+            found = true;
+        }
+    }
+    return found;
+}
+
+// raises the skyline under the new rect and merges neighbours at the same height
+void TextureAtlas::place(Page& page, size_t segment, int x, int y, int width, int height)
+{
+    SkylineSegment new_segment = { x, y + height, width };
+    page.skyline.insert(page.skyline.begin() + segment, new_segment);
+
+    // trim or remove the segments now covered by the new one
+    for (size_t i = segment + 1; i < page.skyline.size(); )
+    {
+        SkylineSegment& current = page.skyline[i];
+        int shadow = x + width - current.x;
+        if (shadow <= 0) break;
+
+        if (shadow >= current.width)
+        {
+            page.skyline.erase(page.skyline.begin() + i);
+            continue;
+        }
+        current.x += shadow;
+        current.width -= shadow;
+        break;
+    }
+
+    for (size_t i = 0; i + 1 < page.skyline.size(); )
+    {
+        if (page.skyline[i].y == page.skyline[i + 1].y)
+        {
+            page.skyline[i].width += page.skyline[i + 1].width;
+            page.skyline.erase(page.skyline.begin() + i + 1);
+        }
+        else i++;
+    }
+
+    page.used_width = std::max(page.used_width, x + width);
+    page.used_height = std::max(page.used_height, y + height);
+}
+
+int TextureAtlas::get_max_mip_level(int padding)
+{
+    int level = 0;
+    while ((2 << level) <= padding / 2) level++;
+    return level;
+}
+
+bool TextureAtlas::pack(const std::vector<glm::ivec2>& sizes, int page_size, int padding)
+{
+    m_page_size = page_size;
+    m_padding = padding;
+    m_border = padding / 2;
+
+    m_pages.clear();
+    m_regions.assign(sizes.size(), AtlasRegion());
+    for (size_t i = 0; i < sizes.size(); i++)
+    {
+        m_regions[i].width = sizes[i].x;
+        m_regions[i].height = sizes[i].y;
+        if (sizes[i].x + padding > m_page_size || sizes[i].y + padding > m_page_size) return false;
+    }
+
+    // pack tallest first -- skyline packers waste the least space that way
+    std::vector<size_t> order(sizes.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+        if (m_regions[a].height != m_regions[b].height) return m_regions[a].height > m_regions[b].height;
+        return m_regions[a].width > m_regions[b].width;
+    });
+
+    for (size_t image : order)
+    {
+        AtlasRegion& region = m_regions[image];
+        int padded_width = region.width + padding,
+            padded_height = region.height + padding;
+
+        int x = 0, y = 0;
+        size_t segment = 0;
+        size_t page = 0;
+        while (page < m_pages.size() && !find_position(m_pages[page], padded_width, padded_height, x, y, segment)) page++;
+
+        if (page == m_pages.size())
+        {
+            Page new_page = { { { 0, 0, m_page_size } }, 0, 0, 0 };
+            m_pages.push_back(new_page);
+            find_position(m_pages[page], padded_width, padded_height, x, y, segment);
+        }
+
+        // the image sits in the middle of its padded cell so the gutter surrounds it on every side
+        place(m_pages[page], segment, x, y, padded_width, padded_height);
+        region.page = (int)page;
+        region.x = x + m_border;
+        region.y = y + m_border;
+    }
+    return true;
+}
+
+bool TextureAtlas::build(const std::vector<std::string>& image_paths, int max_page_size, int padding, AssetLoader* loader)
+{
+    PROFILE_SCOPE("TextureAtlas::build");
+    // never ask for a page bigger than the driver can hold
+    GLint max_texture_size = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
+    int page_size = max_texture_size > 0 ? std::min(max_page_size, (int)max_texture_size) : max_page_size;
+
+    // STEP 1: read only the image headers so we can pack before decoding anything
+    std::vector<glm::ivec2> sizes(image_paths.size());
+    for (size_t i = 0; i < image_paths.size(); i++)
+    {
+        if (!AssetLoader::read_image_size(image_paths[i], sizes[i].x, sizes[i].y))
+        {
+            std::cout << "Unable to read image for atlas: " << image_paths[i] << std::endl;
+            return false;
+        }
+    }
+
+    // STEP 2: lay out every region
+    if (!pack(sizes, page_size, padding))
+    {
+        for (size_t i = 0; i < sizes.size(); i++)
+        {
+            if (sizes[i].x + padding > page_size || sizes[i].y + padding > page_size) std::cout << "Image is too large for an atlas page: " << image_paths[i] << std::endl;
+        }
+        return false;
+    }
+
+    // STEP 3: decode every image straight into its page and upload
+    for (size_t page = 0; page < m_pages.size(); page++)
+    {
+        if (!upload_page(page, image_paths, loader)) return false;
+    }
+    return true;
+}
+
+// copies the image into a block the size of its padded cell and repeats the outermost pixels into the gutter,
+// so filtering past the edge of a sprite picks up its own colour instead of a neighbour's
+void TextureAtlas::extrude(const AtlasRegion& region, const DecodedImage& image, std::vector<unsigned char>& out_block) const
+{
+    const int border = m_border;
+    const int block_width = region.width + 2 * border, block_height = region.height + 2 * border;
+    out_block.resize((size_t)block_width * block_height * 4);
+
+    for (int row = 0; row < block_height; row++)
+    {
+        int source_row = std::min(std::max(row - border, 0), image.height - 1);
+        const unsigned char* source = image.pixels + (size_t)source_row * image.width * 4;
+        unsigned char* destination = out_block.data() + (size_t)row * block_width * 4;
+
+        for (int column = 0; column < border; column++)
+        {
+            std::copy(source, source + 4, destination + (size_t)column * 4);
+            std::copy(source + (size_t)(image.width - 1) * 4, source + (size_t)image.width * 4, destination + (size_t)(border + image.width + column) * 4);
+        }
+        std::copy(source, source + (size_t)image.width * 4, destination + (size_t)border * 4);
+    }
+}
+
+// levels coarser than the gutter would average neighbouring sprites together
+void TextureAtlas::clamp_mip_levels() const
+{
+    if (!m_texture_options.generate_mipmaps && m_texture_options.filter != TEXTURE_FILTER_TRILINEAR) return;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, get_max_mip_level(m_padding));
+}
+
+bool TextureAtlas::upload_page(size_t page_index, const std::vector<std::string>& image_paths, AssetLoader* loader)
+{
+    Page& page = m_pages[page_index];
+
+    std::vector<size_t> images;
+    std::vector<std::string> paths;
+    for (size_t i = 0; i < m_regions.size(); i++)
+    {
+        if (m_regions[i].page != (int)page_index) continue;
+        images.push_back(i);
+        paths.push_back(image_paths[i]);
+    }
+
+    // decode the whole page up front -- spread over the loader's workers when we have one
+    std::vector<DecodedImage> decoded;
+    if (loader != NULL)
+    {
+        decoded = loader->decode_all(paths);
+    }
+    else
+    {
+        for (const std::string& path : paths)
+        {
+            decoded.push_back(AssetLoader::decode_image(path));
+        }
+    }
+
+    // pages are trimmed to what was actually packed
+    const int width = page.used_width, height = page.used_height;
+    std::vector<unsigned char> pixels((size_t)width * height * 4, 0);
+    std::vector<unsigned char> block;
+    bool success = true;
+
+    for (size_t i = 0; i < images.size(); i++)
+    {
+        AtlasRegion& region = m_regions[images[i]];
+        DecodedImage& image = decoded[i];
+
+        if (image.pixels == NULL || image.width != region.width || image.height != region.height)
+        {
+            std::cout << "Unable to load image for atlas: " << image.path << std::endl;
+            success = false;
+            continue;
+        }
+
+        extrude(region, image, block);
+        const int block_width = region.width + 2 * m_border, block_height = region.height + 2 * m_border;
+        for (int row = 0; row < block_height; row++)
+        {
+            std::copy(block.begin() + (size_t)row * block_width * 4,
+                      block.begin() + (size_t)(row + 1) * block_width * 4,
+                      pixels.begin() + ((size_t)(region.y - m_border + row) * width + region.x - m_border) * 4);
+        }
+
+        region.uv_rect = glm::vec4((float)region.x / width,
+                                   (float)region.y / height,
+                                   (float)(region.x + region.width) / width,
+                                   (float)(region.y + region.height) / height);
+    }
+
+    for (DecodedImage& image : decoded) AssetLoader::free_image(image);
+    if (!success) return false;
+
+    page.texture_id = upload_texture(pixels.data(), width, height, m_texture_options);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    clamp_mip_levels();
+
+    return true;
+}
+
+bool TextureAtlas::replace_image(size_t image_index, const DecodedImage& image)
+{
+    const AtlasRegion& region = m_regions[image_index];
+    if (image.pixels == NULL || image.width != region.width || image.height != region.height) return false;
+
+    TextureCompression compression = is_compression_supported(m_texture_options.compression) ? m_texture_options.compression : TEXTURE_COMPRESSION_NONE;
+    if (compression != TEXTURE_COMPRESSION_NONE) return false;
+
+    // the gutter goes up with the image, otherwise filtering at the edges keeps sampling the old pixels
+    std::vector<unsigned char> block;
+    extrude(region, image, block);
+
+    glBindTexture(GL_TEXTURE_2D, m_pages[region.page].texture_id);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, region.x - m_border, region.y - m_border, region.width + 2 * m_border, region.height + 2 * m_border,
+                    GL_RGBA, GL_UNSIGNED_BYTE, block.data());
+    if (m_texture_options.generate_mipmaps || m_texture_options.filter == TEXTURE_FILTER_TRILINEAR) glGenerateMipmap(GL_TEXTURE_2D);
+    return true;
+}
+
+void TextureAtlas::cleanup()
+{
+    for (Page& page : m_pages) glDeleteTextures(1, &page.texture_id);
+    m_pages.clear();
+    m_regions.clear();
+}
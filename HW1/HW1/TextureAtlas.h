@@ -0,0 +1,92 @@
+#pragma once
+
+#ifdef _WINDOWS
+#include <GL/glew.h>
+#endif
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL_opengl.h>
+#include <string>
+#include <vector>
+#include "glm/vec2.hpp"
+#include "glm/vec4.hpp"
+#include "AssetLoader.h"
+#include "TextureUpload.h"
+
+// where a sprite ended up inside the atlas
+struct AtlasRegion
+{
+    int page;           // index into the atlas pages
+    int x, y;           // top left corner in pixels
+    int width, height;
+    glm::vec4 uv_rect;  // (u0, v0, u1, v1) -- v0 is the top edge like the rest of the renderer
+};
+
+// packs many images into one or more GL textures at load time using a skyline packer
+// a whole character then draws without a single texture switch
+class TextureAtlas
+{
+private:
+    // one horizontal run of the skyline -- the packed height from x to x + width
+    struct SkylineSegment
+    {
+        int x, y, width;
+    };
+
+    struct Page
+    {
+        std::vector<SkylineSegment> skyline;
+        int used_width;
+        int used_height;
+        GLuint texture_id;
+    };
+
+    bool find_position(const Page& page, int width, int height, int& out_x, int& out_y, size_t& out_segment) const;
+    int skyline_height(const Page& page, size_t segment, int width) const;
+    void place(Page& page, size_t segment, int x, int y, int width, int height);
+    bool upload_page(size_t page_index, const std::vector<std::string>& image_paths, AssetLoader* loader);
+    void extrude(const AtlasRegion& region, const DecodedImage& image, std::vector<unsigned char>& out_block) const;
+    void clamp_mip_levels() const;
+
+    std::vector<Page> m_pages;
+    std::vector<AtlasRegion> m_regions;
+
+    int m_page_size;
+    int m_padding;
+    int m_border;       // gutter on each side of a region, filled with its own edge pixels
+
+    TextureOptions m_texture_options;
+
+public:
+    static const int DEFAULT_PAGE_SIZE = 8192;
+    static const int DEFAULT_PADDING = 2;
+    static const int MIPMAPPED_PADDING = 16;
+
+    // a mip texel spans 2^level pixels, so only the levels whose texels fit inside the gutter
+    // are kept -- 16 pixels of padding leaves an 8 pixel border and three mip levels
+    static int get_max_mip_level(int padding);
+
+    // filtering, mipmaps and compression for the pages -- set before build()
+    // mips blend neighbouring sprites together at small sizes, so use MIPMAPPED_PADDING with them
+    void set_texture_options(const TextureOptions& options) { m_texture_options = options; };
+
+    // pass an AssetLoader to decode each page's images on its workers
+    bool build(const std::vector<std::string>& image_paths, int max_page_size = DEFAULT_PAGE_SIZE, int padding = DEFAULT_PADDING, AssetLoader* loader = NULL);
+
+    // lays out regions for images of the given sizes without touching GL or the disk -- build() calls
+    // this after reading the image headers, and it can be driven on its own to check a packing
+    // false when an image cannot fit on a page
+    bool pack(const std::vector<glm::ivec2>& sizes, int page_size, int padding);
+    void cleanup();
+
+    // copies a re-decoded image over its region in place -- false when its size changed, which needs a repack,
+    // or when the pages are compressed and cannot be patched
+    bool replace_image(size_t image_index, const DecodedImage& image);
+
+    const AtlasRegion& get_region(size_t image_index) const { return m_regions[image_index]; };
+    GLuint const get_page_texture(int page)            const { return m_pages[page].texture_id; };
+    GLuint const get_texture(size_t image_index)       const { return m_pages[m_regions[image_index].page].texture_id; };
+    size_t const get_page_count()                      const { return m_pages.size(); };
+    size_t const get_region_count()                    const { return m_regions.size(); };
+    int const get_page_width(int page)                 const { return m_pages[page].used_width; };
+    int const get_page_height(int page)                const { return m_pages[page].used_height; };
+};
@@ -0,0 +1,211 @@
+#include "TextureCompression.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    const int BLOCK_SIZE = 4;
+    const int PIXELS_PER_BLOCK = BLOCK_SIZE * BLOCK_SIZE;
+
+    size_t get_block_bytes(TextureCompression compression)
+    {
+        return compression == TEXTURE_COMPRESSION_BC1 ? 8 : 16;
+    }
+
+    unsigned short to_rgb565(const int colour[3])
+    {
+        return (unsigned short)(((colour[0] * 31 + 127) / 255) << 11 |
+                                ((colour[1] * 63 + 127) / 255) << 5 |
+                                ((colour[2] * 31 + 127) / 255));
+    }
+
+    // expands back to 8 bits exactly the way the GPU does, so palette matching is against what is sampled
+    void from_rgb565(unsigned short packed, int colour[3])
+    {
+        int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+        colour[0] = (r << 3) | (r >> 2);
+        colour[1] = (g << 2) | (g >> 4);
+        colour[2] = (b << 3) | (b >> 2);
+    }
+
+    // copies a 4x4 block out of the image, repeating the last row/column past the edges
+    void fetch_block(const unsigned char* rgba, int width, int height, int block_x, int block_y, unsigned char block[PIXELS_PER_BLOCK * 4])
+    {
+        for (int y = 0; y < BLOCK_SIZE; y++)
+        {
+            int source_y = std::min(block_y + y, height - 1);
+            for (int x = 0; x < BLOCK_SIZE; x++)
+            {
+                int source_x = std::min(block_x + x, width - 1);
+                memcpy(&block[(y * BLOCK_SIZE + x) * 4], &rgba[((size_t)source_y * width + source_x) * 4], 4);
+            }
+        }
+    }
+
+    // range fit -- endpoints are the block's bounding box inset by 1/16 to pull them toward the bulk of the colours
+    void encode_colour_block(const unsigned char block[PIXELS_PER_BLOCK * 4], unsigned char out[8])
+    {
+        int low[3] = { 255, 255, 255 }, high[3] = { 0, 0, 0 };
+        for (int i = 0; i < PIXELS_PER_BLOCK; i++)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                low[c] = std::min(low[c], (int)block[i * 4 + c]);
+                high[c] = std::max(high[c], (int)block[i * 4 + c]);
+            }
+        }
+        for (int c = 0; c < 3; c++)
+        {
+            int inset = (high[c] - low[c]) >> 4;
+            low[c] = std::min(255, low[c] + inset);
+            high[c] = std::max(0, high[c] - inset);
+        }
+
+        unsigned short endpoint0 = to_rgb565(high), endpoint1 = to_rgb565(low);
+
+        // endpoint0 > endpoint1 selects the four colour mode
+        if (endpoint0 < endpoint1) std::swap(endpoint0, endpoint1);
+
+        unsigned int indices = 0;
+        if (endpoint0 != endpoint1)
+        {
+            int palette[4][3];
+            from_rgb565(endpoint0, palette[0]);
+            from_rgb565(endpoint1, palette[1]);
+            for (int c = 0; c < 3; c++)
+            {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+
+            for (int i = 0; i < PIXELS_PER_BLOCK; i++)
+            {
+                int best = 0, best_error = 0x7fffffff;
+                for (int p = 0; p < 4; p++)
+                {
+                    int error = 0;
+                    for (int c = 0; c < 3; c++)
+                    {
+                        int difference = (int)block[i * 4 + c] - palette[p][c];
+                        error += difference * difference;
+                    }
+                    if (error < best_error)
+                    {
+                        best_error = error;
+                        best = p;
+                    }
+                }
+                indices |= (unsigned int)best << (i * 2);
+            }
+        }
+
+        out[0] = endpoint0 & 0xff; out[1] = endpoint0 >> 8;
+        out[2] = endpoint1 & 0xff; out[3] = endpoint1 >> 8;
+        out[4] = indices & 0xff; out[5] = (indices >> 8) & 0xff;
+        out[6] = (indices >> 16) & 0xff; out[7] = indices >> 24;
+    }
+
+    // eight interpolated alpha levels between the block's min and max
+    void encode_alpha_block(const unsigned char block[PIXELS_PER_BLOCK * 4], unsigned char out[8])
+    {
+        int low = 255, high = 0;
+        for (int i = 0; i < PIXELS_PER_BLOCK; i++)
+        {
+            low = std::min(low, (int)block[i * 4 + 3]);
+            high = std::max(high, (int)block[i * 4 + 3]);
+        }
+
+        out[0] = (unsigned char)high;
+        out[1] = (unsigned char)low;
+
+        unsigned long long indices = 0;
+        if (high != low)
+        {
+            int palette[8];
+            palette[0] = high;
+            palette[1] = low;
+            for (int p = 1; p < 7; p++) palette[p + 1] = ((7 - p) * high + p * low) / 7;
+
+            for (int i = 0; i < PIXELS_PER_BLOCK; i++)
+            {
+                int alpha = block[i * 4 + 3];
+                int best = 0, best_error = 256;
+                for (int p = 0; p < 8; p++)
+                {
+                    int error = std::abs(alpha - palette[p]);
+                    if (error < best_error)
+                    {
+                        best_error = error;
+                        best = p;
+                    }
+                }
+                indices |= (unsigned long long)best << (i * 3);
+            }
+        }
+
+        for (int b = 0; b < 6; b++) out[2 + b] = (unsigned char)(indices >> (b * 8));
+    }
+}
+
+std::vector<unsigned char> downsample_image(const unsigned char* rgba, int width, int height, int& out_width, int& out_height)
+{
+    out_width = std::max(1, width / 2);
+    out_height = std::max(1, height / 2);
+    std::vector<unsigned char> result((size_t)out_width * out_height * 4);
+
+    for (int y = 0; y < out_height; y++)
+    {
+        int y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+        for (int x = 0; x < out_width; x++)
+        {
+            int x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+            for (int c = 0; c < 4; c++)
+            {
+                int sum = rgba[((size_t)y0 * width + x0) * 4 + c] + rgba[((size_t)y0 * width + x1) * 4 + c] +
+                          rgba[((size_t)y1 * width + x0) * 4 + c] + rgba[((size_t)y1 * width + x1) * 4 + c];
+                result[((size_t)y * out_width + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+            }
+        }
+    }
+    return result;
+}
+
+size_t get_compressed_size(TextureCompression compression, int width, int height)
+{
+    if (compression == TEXTURE_COMPRESSION_NONE) return (size_t)width * height * 4;
+
+    size_t blocks_wide = (width + BLOCK_SIZE - 1) / BLOCK_SIZE,
+           blocks_high = (height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    return blocks_wide * blocks_high * get_block_bytes(compression);
+}
+
+std::vector<unsigned char> compress_image(TextureCompression compression, const unsigned char* rgba, int width, int height)
+{
+    if (compression == TEXTURE_COMPRESSION_NONE)
+    {
+        return std::vector<unsigned char>(rgba, rgba + (size_t)width * height * 4);
+    }
+
+    std::vector<unsigned char> compressed(get_compressed_size(compression, width, height));
+    unsigned char* out = compressed.data();
+    unsigned char block[PIXELS_PER_BLOCK * 4];
+
+    // blocks are stored left to right, top to bottom -- the same order as the rows glTexImage2D takes
+    for (int block_y = 0; block_y < height; block_y += BLOCK_SIZE)
+    {
+        for (int block_x = 0; block_x < width; block_x += BLOCK_SIZE)
+        {
+            fetch_block(rgba, width, height, block_x, block_y, block);
+
+            if (compression == TEXTURE_COMPRESSION_BC3)
+            {
+                encode_alpha_block(block, out);
+                out += 8;
+            }
+            encode_colour_block(block, out);
+            out += 8;
+        }
+    }
+    return compressed;
+}
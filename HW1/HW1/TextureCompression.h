@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// CPU block compression into the S3TC formats every desktop driver (and Mesa's software GL) samples natively
+// BC1 is 8 bytes per 4x4 block (1/8 of RGBA8) with no alpha, BC3 adds a smooth alpha block for 16 bytes (1/4)
+enum TextureCompression { TEXTURE_COMPRESSION_NONE, TEXTURE_COMPRESSION_BC1, TEXTURE_COMPRESSION_BC3 };
+
+// halves an RGBA8 image with a 2x2 box filter -- odd edges reuse the last row/column
+std::vector<unsigned char> downsample_image(const unsigned char* rgba, int width, int height, int& out_width, int& out_height);
+
+// bytes needed for an image of the given size -- blocks are 4x4, partial blocks are padded
+size_t get_compressed_size(TextureCompression compression, int width, int height);
+
+// rgba is tightly packed RGBA8, the result is ready for glCompressedTexImage2D
+std::vector<unsigned char> compress_image(TextureCompression compression, const unsigned char* rgba, int width, int height);
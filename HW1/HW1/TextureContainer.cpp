@@ -0,0 +1,182 @@
+#include "TextureContainer.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#ifdef _WINDOWS
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    uint64_t align_up(uint64_t value)
+    {
+        return (value + CONTAINER_ALIGNMENT - 1) / CONTAINER_ALIGNMENT * CONTAINER_ALIGNMENT;
+    }
+}
+
+bool write_texture_container(const std::string& path, const unsigned char* rgba, int width, int height,
+                             TextureCompression compression, bool generate_mipmaps)
+{
+    // STEP 1: build every level in its final GPU format
+    std::vector<std::vector<unsigned char> > levels;
+    std::vector<TextureContainerLevel> table;
+
+    std::vector<unsigned char> mip;
+    const unsigned char* source = rgba;
+    int level_width = width, level_height = height;
+
+    while (true)
+    {
+        levels.push_back(compress_image(compression, source, level_width, level_height));
+        table.push_back({ 0, levels.back().size(), (uint32_t)level_width, (uint32_t)level_height });
+
+        if (!generate_mipmaps || (level_width == 1 && level_height == 1) || table.size() == CONTAINER_MAX_LEVELS) break;
+
+        int next_width, next_height;
+        mip = downsample_image(source, level_width, level_height, next_width, next_height);
+        source = mip.data();
+        level_width = next_width;
+        level_height = next_height;
+    }
+
+    // STEP 2: lay the levels out on aligned offsets after the header and level table
+    uint64_t offset = align_up(sizeof(TextureContainerHeader) + table.size() * sizeof(TextureContainerLevel));
+    for (TextureContainerLevel& level : table)
+    {
+        level.offset = offset;
+        offset = align_up(offset + level.size);
+    }
+
+    TextureContainerHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = CONTAINER_MAGIC;
+    header.version = CONTAINER_VERSION;
+    header.width = width;
+    header.height = height;
+    header.compression = compression;
+    header.mip_count = (uint32_t)table.size();
+
+    // STEP 3: write it all out, zero filling the alignment gaps
+    std::ofstream outfile(path, std::ios::binary | std::ios::trunc);
+    if (outfile.fail())
+    {
+        std::cout << "Unable to write texture container: " << path << std::endl;
+        return false;
+    }
+
+    outfile.write((const char*)&header, sizeof(header));
+    outfile.write((const char*)table.data(), table.size() * sizeof(TextureContainerLevel));
+
+    const char zeros[CONTAINER_ALIGNMENT] = { 0 };
+    for (size_t i = 0; i < levels.size(); i++)
+    {
+        uint64_t position = (uint64_t)outfile.tellp();
+        outfile.write(zeros, (std::streamsize)(table[i].offset - position));
+        outfile.write((const char*)levels[i].data(), levels[i].size());
+    }
+    uint64_t position = (uint64_t)outfile.tellp();
+    outfile.write(zeros, (std::streamsize)(align_up(position) - position));
+
+    return outfile.good();
+}
+
+MappedTexture::MappedTexture() : m_data(NULL), m_size(0)
+{
+#ifdef _WINDOWS
+    m_file = INVALID_HANDLE_VALUE;
+    m_mapping = NULL;
+#else
+    m_file = -1;
+#endif
+}
+
+MappedTexture::~MappedTexture()
+{
+    close();
+}
+
+bool MappedTexture::open(const std::string& path)
+{
+    close();
+
+#ifdef _WINDOWS
+    m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (m_file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(m_file, &file_size);
+    m_size = (size_t)file_size.QuadPart;
+
+    m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (m_mapping != NULL) m_data = (const unsigned char*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+    m_file = ::open(path.c_str(), O_RDONLY);
+    if (m_file < 0) return false;
+
+    struct stat file_info;
+    fstat(m_file, &file_info);
+    m_size = (size_t)file_info.st_size;
+
+    void* mapping = m_size > 0 ? mmap(NULL, m_size, PROT_READ, MAP_PRIVATE, m_file, 0) : MAP_FAILED;
+    if (mapping != MAP_FAILED)
+    {
+        m_data = (const unsigned char*)mapping;
+
+        // the whole file is about to be read front to back by the driver
+        madvise(mapping, m_size, MADV_WILLNEED);
+    }
+#endif
+
+    if (m_data == NULL || m_size < sizeof(TextureContainerHeader))
+    {
+        close();
+        return false;
+    }
+
+    // refuse anything that would send GL reading past the end of the mapping
+    const TextureContainerHeader& header = get_header();
+    bool valid = header.magic == CONTAINER_MAGIC && header.version == CONTAINER_VERSION &&
+                 header.compression <= (uint32_t)TEXTURE_COMPRESSION_BC3 &&
+                 header.mip_count > 0 && header.mip_count <= CONTAINER_MAX_LEVELS &&
+                 sizeof(TextureContainerHeader) + header.mip_count * sizeof(TextureContainerLevel) <= m_size;
+
+    for (uint32_t i = 0; valid && i < header.mip_count; i++)
+    {
+        const TextureContainerLevel& level = get_level(i);
+        valid = level.offset <= m_size && level.size <= m_size - level.offset &&
+                level.size == get_compressed_size((TextureCompression)header.compression, level.width, level.height);
+    }
+
+    if (!valid)
+    {
+        std::cout << "Invalid texture container: " << path << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MappedTexture::close()
+{
+#ifdef _WINDOWS
+    if (m_data != NULL) UnmapViewOfFile(m_data);
+    if (m_mapping != NULL) CloseHandle(m_mapping);
+    if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+    m_mapping = NULL;
+    m_file = INVALID_HANDLE_VALUE;
+#else
+    if (m_data != NULL) munmap((void*)m_data, m_size);
+    if (m_file >= 0) ::close(m_file);
+    m_file = -1;
+#endif
+    m_data = NULL;
+    m_size = 0;
+}
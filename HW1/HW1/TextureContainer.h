@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include "TextureCompression.h"
+
+// .gtex -- GPU-ready texture container written by the TextureBaker tool
+//
+//   [TextureContainerHeader][TextureContainerLevel x mip_count][padding][level 0][padding][level 1]...
+//
+// every level is stored exactly as glTexImage2D / glCompressedTexImage2D expects it and starts on a
+// CONTAINER_ALIGNMENT boundary, so the runtime maps the file and hands GL pointers straight into it
+
+const uint32_t CONTAINER_MAGIC = 0x58455447; // "GTEX"
+const uint32_t CONTAINER_VERSION = 1;
+const uint32_t CONTAINER_ALIGNMENT = 64;
+const uint32_t CONTAINER_MAX_LEVELS = 16;
+
+struct TextureContainerHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t compression;  // TextureCompression
+    uint32_t mip_count;
+    uint32_t reserved[10]; // pads the header to 64 bytes
+};
+
+struct TextureContainerLevel
+{
+    uint64_t offset;       // from the start of the file
+    uint64_t size;
+    uint32_t width;
+    uint32_t height;
+};
+
+// baker side -- builds the mip chain, compresses it and writes the container
+bool write_texture_container(const std::string& path, const unsigned char* rgba, int width, int height,
+                             TextureCompression compression, bool generate_mipmaps);
+
+// runtime side -- a read-only memory mapping of a container file
+class MappedTexture
+{
+private:
+    const unsigned char* m_data;
+    size_t m_size;
+
+#ifdef _WINDOWS
+    void* m_file;
+    void* m_mapping;
+#else
+    int m_file;
+#endif
+
+public:
+    MappedTexture();
+    ~MappedTexture();
+
+    bool open(const std::string& path);
+    void close();
+
+    const TextureContainerHeader& get_header()       const { return *(const TextureContainerHeader*)m_data; };
+    const TextureContainerLevel& get_level(int level) const { return ((const TextureContainerLevel*)(m_data + sizeof(TextureContainerHeader)))[level]; };
+    const unsigned char* get_level_data(int level)    const { return m_data + get_level(level).offset; };
+};
@@ -0,0 +1,170 @@
+#define GL_SILENCE_DEPRECATION
+
+#include "TextureStreamer.h"
+#include <algorithm>
+#include <cstring>
+
+const int BYTES_PER_PIXEL = 4;
+
+void TextureStreamer::initialise(size_t bytes_per_frame, int ring_size)
+{
+    m_bytes_per_frame = bytes_per_frame;
+    m_buffer_size = bytes_per_frame;
+    m_next_buffer = 0;
+    m_bytes_uploaded = 0;
+
+    // several buffers in flight so we never write into one the GPU is still reading from
+    m_pixel_buffers.resize(ring_size);
+    glGenBuffers(ring_size, m_pixel_buffers.data());
+    for (GLuint buffer : m_pixel_buffers)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, m_buffer_size, NULL, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void TextureStreamer::cleanup()
+{
+    for (Job& job : m_jobs) AssetLoader::free_image(job.image);
+    m_jobs.clear();
+    m_resident.clear();
+
+    glDeleteBuffers((GLsizei)m_pixel_buffers.size(), m_pixel_buffers.data());
+    m_pixel_buffers.clear();
+}
+
+GLuint TextureStreamer::enqueue(DecodedImage image)
+{
+    GLuint texture_id;
+    glGenTextures(1, &texture_id);
+    glBindTexture(GL_TEXTURE_2D, texture_id);
+
+    // storage only -- the pixels arrive over the next few frames
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width, image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    apply_texture_filter(m_texture_options);
+
+    // a row is the smallest piece we upload, so very wide images stretch the budget to one row
+    size_t row_bytes = (size_t)image.width * BYTES_PER_PIXEL;
+    if (row_bytes > m_buffer_size) m_buffer_size = row_bytes;
+
+    m_jobs.push_back({ texture_id, image, 0 });
+    return texture_id;
+}
+
+void TextureStreamer::update()
+{
+    if (m_jobs.empty()) return;
+
+    GLuint buffer = m_pixel_buffers[m_next_buffer];
+    m_next_buffer = (m_next_buffer + 1) % m_pixel_buffers.size();
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+
+    // orphan the old contents so mapping never waits on a pending upload
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, m_buffer_size, NULL, GL_STREAM_DRAW);
+    unsigned char* staging = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, m_buffer_size,
+                                                              GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (staging == NULL)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return;
+    }
+
+    // STEP 1: copy whole rows into the staging buffer until the budget runs out
+    struct Chunk { GLuint texture_id; int first_row, rows, width; size_t offset; };
+    std::vector<Chunk> chunks;
+    size_t used = 0;
+
+    for (Job& job : m_jobs)
+    {
+        size_t row_bytes = (size_t)job.image.width * BYTES_PER_PIXEL;
+
+        // the buffer always holds at least one row (see enqueue), so the first job always progresses
+        size_t rows_that_fit = (m_buffer_size - used) / row_bytes;
+        if (rows_that_fit == 0) break;
+
+        int rows = (int)std::min(rows_that_fit, (size_t)(job.image.height - job.next_row));
+
+        memcpy(staging + used, job.image.pixels + (size_t)job.next_row * row_bytes, rows * row_bytes);
+        chunks.push_back({ job.texture_id, job.next_row, rows, job.image.width, used });
+
+        used += rows * row_bytes;
+        job.next_row += rows;
+        if (job.next_row < job.image.height) break;
+    }
+
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    // STEP 2: point each texture at its slice of the buffer -- the copy happens on the GPU's time
+    for (const Chunk& chunk : chunks)
+    {
+        glBindTexture(GL_TEXTURE_2D, chunk.texture_id);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, chunk.first_row, chunk.width, chunk.rows,
+                        GL_RGBA, GL_UNSIGNED_BYTE, (const void*)chunk.offset);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    m_bytes_uploaded += used;
+
+    // STEP 3: retire finished textures
+    while (!m_jobs.empty() && m_jobs.front().next_row >= m_jobs.front().image.height)
+    {
+        retire(m_jobs.front());
+        m_jobs.pop_front();
+    }
+}
+
+void TextureStreamer::retire(Job& job)
+{
+    // mips can only be built once every row of the base level is in
+    if (m_texture_options.generate_mipmaps || m_texture_options.filter == TEXTURE_FILTER_TRILINEAR)
+    {
+        glBindTexture(GL_TEXTURE_2D, job.texture_id);
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+
+    m_resident.insert(std::upper_bound(m_resident.begin(), m_resident.end(), job.texture_id), job.texture_id);
+    AssetLoader::free_image(job.image);
+}
+
+void TextureStreamer::finish(GLuint texture_id)
+{
+    for (auto job = m_jobs.begin(); job != m_jobs.end(); ++job)
+    {
+        if (job->texture_id != texture_id) continue;
+
+        // no unpack buffer bound, so GL reads the rows from the decoded image during the call
+        if (job->next_row < job->image.height)
+        {
+            size_t row_bytes = (size_t)job->image.width * BYTES_PER_PIXEL;
+            glBindTexture(GL_TEXTURE_2D, job->texture_id);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, job->next_row, job->image.width, job->image.height - job->next_row,
+                            GL_RGBA, GL_UNSIGNED_BYTE, job->image.pixels + (size_t)job->next_row * row_bytes);
+            m_bytes_uploaded += (size_t)(job->image.height - job->next_row) * row_bytes;
+            job->next_row = job->image.height;
+        }
+
+        retire(*job);
+        m_jobs.erase(job);
+        return;
+    }
+}
+
+void TextureStreamer::release(GLuint texture_id)
+{
+    auto resident = std::lower_bound(m_resident.begin(), m_resident.end(), texture_id);
+    if (resident != m_resident.end() && *resident == texture_id) m_resident.erase(resident);
+
+    for (auto job = m_jobs.begin(); job != m_jobs.end(); ++job)
+    {
+        if (job->texture_id != texture_id) continue;
+        AssetLoader::free_image(job->image);
+        m_jobs.erase(job);
+        return;
+    }
+}
+
+bool TextureStreamer::is_resident(GLuint texture_id) const
+{
+    return std::binary_search(m_resident.begin(), m_resident.end(), texture_id);
+}
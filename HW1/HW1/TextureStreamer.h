@@ -0,0 +1,64 @@
+#pragma once
+
+#ifdef _WINDOWS
+#include <GL/glew.h>
+#endif
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL_opengl.h>
+#include <deque>
+#include <vector>
+#include "AssetLoader.h"
+#include "TextureUpload.h"
+
+// uploads decoded images a few rows at a time through a ring of pixel unpack buffers
+// at most the byte budget is copied per frame, so loading mid-game never hitches for a whole texture
+class TextureStreamer
+{
+private:
+    struct Job
+    {
+        GLuint texture_id;
+        DecodedImage image;
+        int next_row;
+    };
+
+    void retire(Job& job);
+
+    std::deque<Job> m_jobs;
+    std::vector<GLuint> m_resident;      // finished textures, sorted for lookup
+
+    std::vector<GLuint> m_pixel_buffers;
+    size_t m_next_buffer;
+    size_t m_buffer_size;
+    size_t m_bytes_per_frame;
+
+    size_t m_bytes_uploaded;             // lifetime total, for reporting
+
+    TextureOptions m_texture_options;    // filtering and mipmaps only -- rows are streamed uncompressed
+
+public:
+    static const int DEFAULT_RING_SIZE = 3;
+
+    void initialise(size_t bytes_per_frame, int ring_size = DEFAULT_RING_SIZE);
+    void cleanup();
+
+    void set_texture_options(const TextureOptions& options) { m_texture_options = options; };
+
+    // allocates the texture right away and takes ownership of the pixels
+    // the texture is not safe to sample until is_resident() says so
+    GLuint enqueue(DecodedImage image);
+
+    // uploads up to the byte budget -- call once per frame on the GL thread
+    void update();
+
+    // uploads whatever is left of one texture straight from client memory, skipping the budget
+    // and the ring -- for callers that must block until it can be sampled
+    void finish(GLuint texture_id);
+
+    // forgets a texture the caller is about to delete, dropping its pixels if still streaming
+    void release(GLuint texture_id);
+
+    bool is_resident(GLuint texture_id) const;
+    bool const is_idle()                const { return m_jobs.empty(); };
+    size_t const get_bytes_uploaded()   const { return m_bytes_uploaded; };
+};
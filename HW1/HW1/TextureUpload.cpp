@@ -0,0 +1,160 @@
+#define GL_SILENCE_DEPRECATION
+
+#include "TextureUpload.h"
+#include <SDL.h>
+#include <algorithm>
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT  0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+namespace
+{
+    GLenum get_internal_format(TextureCompression compression)
+    {
+        switch (compression)
+        {
+        case TEXTURE_COMPRESSION_BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case TEXTURE_COMPRESSION_BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        default:                      return GL_RGBA;
+        }
+    }
+
+    void upload_level(GLint level, const unsigned char* rgba, int width, int height, TextureCompression compression)
+    {
+        if (compression == TEXTURE_COMPRESSION_NONE)
+        {
+            glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+            return;
+        }
+
+        std::vector<unsigned char> blocks = compress_image(compression, rgba, width, height);
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, get_internal_format(compression), width, height, 0, (GLsizei)blocks.size(), blocks.data());
+    }
+}
+
+bool is_compression_supported(TextureCompression compression)
+{
+    if (compression == TEXTURE_COMPRESSION_NONE) return true;
+    return SDL_GL_ExtensionSupported("GL_EXT_texture_compression_s3tc") == SDL_TRUE;
+}
+
+void apply_texture_filter(const TextureOptions& options)
+{
+    bool mipmaps = options.generate_mipmaps || options.filter == TEXTURE_FILTER_TRILINEAR;
+
+    GLint min_filter = GL_NEAREST, mag_filter = GL_NEAREST;
+    switch (options.filter)
+    {
+    case TEXTURE_FILTER_NEAREST:
+        min_filter = mipmaps ? GL_NEAREST_MIPMAP_NEAREST : GL_NEAREST;
+        break;
+    case TEXTURE_FILTER_BILINEAR:
+        min_filter = mipmaps ? GL_LINEAR_MIPMAP_NEAREST : GL_LINEAR;
+        mag_filter = GL_LINEAR;
+        break;
+    case TEXTURE_FILTER_TRILINEAR:
+        min_filter = GL_LINEAR_MIPMAP_LINEAR;
+        mag_filter = GL_LINEAR;
+        break;
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, min_filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, mag_filter);
+}
+
+GLuint upload_texture(const unsigned char* rgba, int width, int height, const TextureOptions& options)
+{
+    GLuint texture_id;
+    glGenTextures(1, &texture_id);
+    reupload_texture(texture_id, rgba, width, height, options);
+    return texture_id;
+}
+
+void reupload_texture(GLuint texture_id, const unsigned char* rgba, int width, int height, const TextureOptions& options)
+{
+    TextureCompression compression = is_compression_supported(options.compression) ? options.compression : TEXTURE_COMPRESSION_NONE;
+    bool mipmaps = options.generate_mipmaps || options.filter == TEXTURE_FILTER_TRILINEAR;
+
+    glBindTexture(GL_TEXTURE_2D, texture_id);
+
+    upload_level(0, rgba, width, height, compression);
+
+    if (mipmaps && compression == TEXTURE_COMPRESSION_NONE)
+    {
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+    else if (mipmaps)
+    {
+        // drivers cannot generate mips for compressed storage, so build and compress the chain here
+        std::vector<unsigned char> level_pixels;
+        const unsigned char* source = rgba;
+        int level_width = width, level_height = height;
+
+        for (GLint level = 1; level_width > 1 || level_height > 1; level++)
+        {
+            int next_width, next_height;
+            level_pixels = downsample_image(source, level_width, level_height, next_width, next_height);
+            level_width = next_width;
+            level_height = next_height;
+            source = level_pixels.data();
+
+            upload_level(level, source, level_width, level_height, compression);
+        }
+    }
+
+    TextureOptions applied = options;
+    applied.generate_mipmaps = mipmaps;
+    apply_texture_filter(applied);
+}
+
+size_t get_texture_memory(int width, int height, const TextureOptions& options)
+{
+    TextureCompression compression = is_compression_supported(options.compression) ? options.compression : TEXTURE_COMPRESSION_NONE;
+    bool mipmaps = options.generate_mipmaps || options.filter == TEXTURE_FILTER_TRILINEAR;
+
+    size_t total = get_compressed_size(compression, width, height);
+    while (mipmaps && (width > 1 || height > 1))
+    {
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+        total += get_compressed_size(compression, width, height);
+    }
+    return total;
+}
+
+GLuint upload_texture_container(const MappedTexture& container, const TextureOptions& options)
+{
+    const TextureContainerHeader& header = container.get_header();
+    TextureCompression compression = (TextureCompression)header.compression;
+    if (!is_compression_supported(compression)) return 0;
+
+    GLuint texture_id;
+    glGenTextures(1, &texture_id);
+    glBindTexture(GL_TEXTURE_2D, texture_id);
+
+    for (uint32_t level = 0; level < header.mip_count; level++)
+    {
+        const TextureContainerLevel& info = container.get_level(level);
+        const unsigned char* data = container.get_level_data(level);
+
+        if (compression == TEXTURE_COMPRESSION_NONE)
+        {
+            glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, info.width, info.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+        }
+        else
+        {
+            glCompressedTexImage2D(GL_TEXTURE_2D, level, get_internal_format(compression), info.width, info.height, 0, (GLsizei)info.size, data);
+        }
+    }
+
+    // the baker may stop short of 1x1, so tell GL where the chain ends
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, header.mip_count - 1);
+
+    TextureOptions applied = options;
+    applied.generate_mipmaps = header.mip_count > 1;
+    if (!applied.generate_mipmaps && applied.filter == TEXTURE_FILTER_TRILINEAR) applied.filter = TEXTURE_FILTER_BILINEAR;
+    apply_texture_filter(applied);
+
+    return texture_id;
+}
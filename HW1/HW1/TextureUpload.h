@@ -0,0 +1,41 @@
+#pragma once
+
+#ifdef _WINDOWS
+#include <GL/glew.h>
+#endif
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL_opengl.h>
+#include <vector>
+#include "TextureCompression.h"
+#include "TextureContainer.h"
+
+enum TextureFilter { TEXTURE_FILTER_NEAREST, TEXTURE_FILTER_BILINEAR, TEXTURE_FILTER_TRILINEAR };
+
+// how load_texture() builds the GL texture -- the defaults match the original nearest, uncompressed upload
+struct TextureOptions
+{
+    TextureFilter filter;
+    bool generate_mipmaps;               // required for TEXTURE_FILTER_TRILINEAR
+    TextureCompression compression;      // falls back to RGBA8 when the driver lacks S3TC
+
+    TextureOptions() : filter(TEXTURE_FILTER_NEAREST), generate_mipmaps(false), compression(TEXTURE_COMPRESSION_NONE) {}
+};
+
+bool is_compression_supported(TextureCompression compression);
+
+// sets the min/mag filters for the currently bound texture
+void apply_texture_filter(const TextureOptions& options);
+
+// creates a texture from tightly packed RGBA8 pixels
+GLuint upload_texture(const unsigned char* rgba, int width, int height, const TextureOptions& options);
+
+// replaces the contents of an existing texture, size included -- the id stays the same so nothing that holds it notices
+void reupload_texture(GLuint texture_id, const unsigned char* rgba, int width, int height, const TextureOptions& options);
+
+// bytes of GPU memory the texture takes, including its mip chain
+size_t get_texture_memory(int width, int height, const TextureOptions& options);
+
+// creates a texture straight from a mapped .gtex container -- no decode and no intermediate copy
+// only the filter in the options is used, mips and compression come from the file
+// returns 0 when the driver cannot sample the container's format
+GLuint upload_texture_container(const MappedTexture& container, const TextureOptions& options);
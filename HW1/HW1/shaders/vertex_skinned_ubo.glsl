@@ -0,0 +1,47 @@
+#version 120
+#extension GL_ARB_uniform_buffer_object : require
+
+attribute vec4 position;
+attribute vec2 texCoord;
+attribute vec2 boneIndices;
+attribute vec2 boneWeights;
+
+uniform mat4 modelMatrix;
+
+layout(std140) uniform Camera
+{
+    mat4 viewMatrix;
+    mat4 projectionMatrix;
+};
+
+// one entry per bone -- the real and dual parts of a unit dual quaternion (x, y, z, w),
+// and the bind pivot (x, y) with the scale applied about it (z)
+uniform vec4 boneReal[16];
+uniform vec4 boneDual[16];
+uniform vec4 bonePivotScale[16];
+
+varying vec2 texCoordVar;
+
+void main()
+{
+    int first = int(boneIndices.x);
+    int second = int(boneIndices.y);
+
+    // keep both in the same hemisphere so the blend takes the short way round
+    float secondWeight = dot(boneReal[first], boneReal[second]) < 0.0 ? -boneWeights.y : boneWeights.y;
+    vec4 real = boneReal[first] * boneWeights.x + boneReal[second] * secondWeight;
+    vec4 dual = boneDual[first] * boneWeights.x + boneDual[second] * secondWeight;
+    float magnitude = length(real);
+    real /= magnitude;
+    dual /= magnitude;
+
+    vec3 pivotScale = bonePivotScale[first].xyz * boneWeights.x + bonePivotScale[second].xyz * boneWeights.y;
+    vec3 p = vec3(pivotScale.xy + (position.xy - pivotScale.xy) * pivotScale.z, 0.0);
+
+    // rotate by the real part, then translate by 2 * dual * conjugate(real)
+    vec3 rotated = p + 2.0 * cross(real.xyz, cross(real.xyz, p) + real.w * p);
+    vec3 translation = 2.0 * (real.w * dual.xyz - dual.w * real.xyz + cross(real.xyz, dual.xyz));
+
+    texCoordVar = texCoord;
+    gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(rotated + translation, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,25 @@
+#version 120
+#extension GL_ARB_uniform_buffer_object : require
+
+attribute vec4 position;
+attribute vec2 texCoord;
+
+// per instance -- the quad's half axes (x axis in xy, y axis in zw), its centre and its (u0, v0, u1, v1) rect
+attribute vec4 instanceAxes;
+attribute vec2 instanceOrigin;
+attribute vec4 instanceUvRect;
+
+layout(std140) uniform Camera
+{
+    mat4 viewMatrix;
+    mat4 projectionMatrix;
+};
+
+varying vec2 texCoordVar;
+
+void main()
+{
+    vec2 p = instanceOrigin + instanceAxes.xy * position.x + instanceAxes.zw * position.y;
+    texCoordVar = mix(instanceUvRect.xy, instanceUvRect.zw, texCoord);
+    gl_Position = projectionMatrix * viewMatrix * vec4(p, 0.0, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,22 @@
+#version 120
+#extension GL_ARB_uniform_buffer_object : require
+
+attribute vec4 position;
+attribute vec2 texCoord;
+
+uniform mat4 modelMatrix;
+
+layout(std140) uniform Camera
+{
+    mat4 viewMatrix;
+    mat4 projectionMatrix;
+};
+
+varying vec2 texCoordVar;
+
+void main()
+{
+	vec4 p = viewMatrix * modelMatrix  * position;
+    texCoordVar = texCoord;
+	gl_Position = projectionMatrix * p;
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+/**
+* TextureBaker -- converts images into GPU-ready .gtex containers (see TextureContainer.h)
+*
+*   TextureBaker [--bc1 | --bc3] [--no-mips] image.png [image.png ...]
+*
+* each image.png is written next to itself as image.gtex. The game picks the baked
+* files up instead of the PNGs, so startup no longer inflates and unfilters them.
+**/
+
+#define STB_IMAGE_IMPLEMENTATION
+
+#include <cstring>
+#include <iostream>
+#include <string>
+#include "stb_image.h"
+#include "TextureContainer.h"
+
+#define LOG(argument) std::cout << argument << '\n'
+
+// swaps the extension for .gtex
+std::string get_output_path(const std::string& input_path)
+{
+    size_t dot = input_path.find_last_of('.');
+    size_t slash = input_path.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) return input_path + ".gtex";
+    return input_path.substr(0, dot) + ".gtex";
+}
+
+bool bake(const std::string& input_path, TextureCompression compression, bool generate_mipmaps)
+{
+    int width, height, number_of_components;
+    unsigned char* image = stbi_load(input_path.c_str(), &width, &height, &number_of_components, STBI_rgb_alpha);
+
+    if (image == NULL)
+    {
+        LOG("Unable to load image: " << input_path);
+        return false;
+    }
+
+    std::string output_path = get_output_path(input_path);
+    bool success = write_texture_container(output_path, image, width, height, compression, generate_mipmaps);
+    stbi_image_free(image);
+
+    if (success) LOG(input_path << " -> " << output_path << " (" << width << "x" << height << ")");
+    return success;
+}
+
+int main(int argc, char* argv[])
+{
+    TextureCompression compression = TEXTURE_COMPRESSION_NONE;
+    bool generate_mipmaps = true;
+    int baked = 0, failed = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--bc1") == 0)           compression = TEXTURE_COMPRESSION_BC1;
+        else if (strcmp(argv[i], "--bc3") == 0)      compression = TEXTURE_COMPRESSION_BC3;
+        else if (strcmp(argv[i], "--no-mips") == 0)  generate_mipmaps = false;
+        else if (bake(argv[i], compression, generate_mipmaps)) baked++;
+        else failed++;
+    }
+
+    if (baked + failed == 0)
+    {
+        LOG("usage: TextureBaker [--bc1 | --bc3] [--no-mips] image.png [image.png ...]");
+        return 1;
+    }
+    return failed == 0 ? 0 : 1;
+}